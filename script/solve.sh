@@ -0,0 +1,56 @@
+#!/bin/bash
+# TIME_LIMIT を rounds 回に分けて LKH を実行し、
+# ラウンドごとに下界とのギャップが max_gap 以下になれば打ち切る
+lkh=$1
+bound=$2
+par_file=$3
+max_gap=$4
+rounds=$5
+problem_file=$(grep '^PROBLEM_FILE' $par_file | sed 's/^[^=]*= *//')
+tour_file=$(grep '^TOUR_FILE' $par_file | sed 's/^[^=]*= *//')
+time_limit=$(grep '^TIME_LIMIT' $par_file | sed 's/^[^=]*= *//')
+initial_tour_file=$(grep '^INITIAL_TOUR_FILE' $par_file | sed 's/^[^=]*= *//')
+round_time=$((time_limit / rounds))
+work_dir=$(mktemp -d)
+# 下界は 1 回目のラウンドと並行して一度だけ求め、求まるまでは打ち切らない
+$bound $problem_file > $work_dir/bound.csv &
+bound_pid=$!
+trap 'kill $bound_pid 2>/dev/null; rm -rf $work_dir' EXIT
+lower_bound=""
+round_par=$work_dir/railway.par
+# LKH の前処理の結果は 1 回目に保存し、2 回目以降は読み込む
+grep -v -e '^TIME_LIMIT' -e '^INITIAL_TOUR_FILE' $par_file > $work_dir/base.par
+if ! grep -q '^PI_FILE' $par_file; then
+    echo "PI_FILE = $work_dir/lkh.pi" >> $work_dir/base.par
+fi
+if ! grep -q '^CANDIDATE_FILE' $par_file; then
+    echo "CANDIDATE_FILE = $work_dir/lkh.cand" >> $work_dir/base.par
+fi
+rm -f $tour_file
+for ((i = 0; i < rounds; ++i)); do
+    cp $work_dir/base.par $round_par
+    echo "TIME_LIMIT = $round_time" >> $round_par
+    if [ -f $tour_file ]; then
+        echo "INITIAL_TOUR_FILE = $tour_file" >> $round_par
+    elif [ -n "$initial_tour_file" ]; then
+        echo "INITIAL_TOUR_FILE = $initial_tour_file" >> $round_par
+    fi
+    $lkh $round_par || exit 1
+    if [ -z "$lower_bound" ] && ! kill -0 $bound_pid 2>/dev/null; then
+        wait $bound_pid
+        status=$?
+        if [ $status -ne 0 ]; then
+            echo "bound failed with status $status" >&2
+            exit 1
+        fi
+        lower_bound=$(tail -n 1 $work_dir/bound.csv)
+    fi
+    # LKH はツアーの長さを COMMENT に書く
+    length=$(grep '^COMMENT : Length' $tour_file | sed 's/^[^=]*= *//')
+    if [ -n "$lower_bound" ] &&
+        awk -v tour_length=$length -v lower_bound=$lower_bound \
+            -v max_gap=$max_gap \
+            'BEGIN { exit !(tour_length <= lower_bound * (1 + max_gap)) }'; then
+        break
+    fi
+done
@@ -0,0 +1,95 @@
+#include "railway.h"
+#include <bits/stdc++.h>
+
+using namespace railway;
+using namespace std;
+
+const int MAX_ITERATIONS = 3000;
+const int CANDIDATE_SIZE = 30;
+
+vector<double> readPi(const string &file_path, size_t N) {
+    vector<double> pi;
+    ifstream fs(file_path);
+    double value;
+    while (fs >> value) {
+        pi.push_back(value);
+    }
+    if (pi.size() != N) {
+        return {};
+    }
+    return pi;
+}
+
+void writePi(const string &file_path, const vector<double> &pi) {
+    ofstream fs(file_path);
+    fs << setprecision(17);
+    for (double value : pi) {
+        fs << value << "\n";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    // tour_file を省くと下界だけを求める。pi_file を指定すると上昇法で求めた
+    // pi を保存し、次からは読み込んで 1-tree を 1 度作るだけにする
+    if (argc != 2 && argc != 4 && argc != 5) {
+        cerr << "Usage: ./bound <tsp_file> [<tour_file> <max_gap> "
+                "[<pi_file>]]"
+             << endl;
+        return -1;
+    }
+
+    string tsp_file{argv[1]};
+    vector<vector<int>> cost = readProblem(tsp_file);
+    const int N = cost.size();
+    if (N == 0) {
+        cerr << "Failed to read problem." << endl;
+        return -1;
+    }
+    if (argc == 2) {
+        vector<double> pi(N, 0);
+        double bound = HeldKarp(cost, CANDIDATE_SIZE)
+                           .calcLowerBound(DBL_MAX, MAX_ITERATIONS, pi);
+        cout << "lower_bound" << endl;
+        cout << (long long)ceil(bound - 1e-6) << endl;
+        return 0;
+    }
+
+    string tour_file{argv[2]};
+    double max_gap = stod(argv[3]);
+    string pi_file = argc == 5 ? argv[4] : "";
+
+    vector<int> tour = readTour(tour_file);
+    if (tour.size() != cost.size()) {
+        cerr << "Failed to read problem or tour." << endl;
+        return -1;
+    }
+
+    long long length = calcTourLength(cost, tour);
+
+    vector<double> pi;
+    if (!pi_file.empty()) {
+        pi = readPi(pi_file, N);
+    }
+    bool reuse = !pi.empty();
+    if (!reuse) {
+        pi.assign(N, 0);
+    }
+    HeldKarp heldKarp(cost, CANDIDATE_SIZE);
+    double bound = heldKarp.calcLowerBound(length / (1 + max_gap),
+                                           reuse ? 1 : MAX_ITERATIONS, pi);
+    if (!pi_file.empty() && !reuse) {
+        writePi(pi_file, pi);
+    }
+    // 辺の重みは整数なので切り上げてよい
+    long long lower_bound = min((long long)ceil(bound - 1e-6), length);
+    double gap = length == lower_bound
+                     ? 0.0
+                     : (double)(length - lower_bound) / max(lower_bound, 1LL);
+
+    cout << "length,lower_bound,gap" << endl;
+    cout << length << "," << lower_bound << "," << fixed << setprecision(6)
+         << gap << endl;
+
+    // ギャップが閾値以下なら 0、超えていれば 1 を返して探索を続けさせる
+    return gap <= max_gap ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#include "railway.h"
+#include <bits/stdc++.h>
+#include <nlohmann/json.hpp>
+
+using namespace railway;
+using namespace std;
+using json = nlohmann::json;
+
+int main(int argc, char *argv[]) {
+    if (argc != 5) {
+        cerr << "Usage: ./nearest <station_file> <query_file> <k> <radius_km>"
+             << endl;
+        return -1;
+    }
+
+    string station_file{argv[1]};
+    string query_file{argv[2]};
+    // -1 なら制限しない
+    int k = stoi(argv[3]);
+    double radius = stod(argv[4]);
+
+    vector<Station> stations = readStations(station_file);
+    StationIndex stationIndex(stations);
+
+    vector<Coordinate> queries = readCoordinates(query_file);
+    vector<vector<NearStation>> results =
+        stationIndex.search(queries, k, radius);
+
+    json j;
+    j["results"] = json::array();
+    for (const vector<NearStation> &result : results) {
+        json stations = json::array();
+        for (const NearStation &near : result) {
+            stations.push_back(
+                {{"station_code", near.station.station_code},
+                 {"station_name", near.station.station_name},
+                 {"distance", near.distance}});
+        }
+        j["results"].push_back({{"stations", stations}});
+    }
+    cout << j << endl;
+
+    return 0;
+}
@@ -0,0 +1,319 @@
+#include "railway.h"
+#include <bits/stdc++.h>
+#include <csignal>
+#include <nlohmann/json.hpp>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace railway;
+using namespace std;
+using json = nlohmann::json;
+
+const int TOKYO = 1130101;
+const int NEIGHBOR_SIZE = 10;
+const int MAX_MOVES = 10000000;
+
+bool writeAll(int fd, const string &s) {
+    size_t written = 0;
+    while (written < s.size()) {
+        ssize_t n = write(fd, s.data() + written, s.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+// LKH を子プロセスで起動し、問題は標準入力のパイプから渡す。
+// パラメータファイルの PROBLEM_FILE と TOUR_FILE は一時ファイルに置き換える。
+class LkhProcess {
+  public:
+    LkhProcess(const string &lkh_file, const string &par_file) {
+        char dir_template[] = "/tmp/pipelineXXXXXX";
+        if (mkdtemp(dir_template) == nullptr) {
+            throw runtime_error("Failed to create a temporary directory.");
+        }
+        dir = dir_template;
+        tour_file = dir + "/railway.lkh";
+        round_par_file = dir + "/railway.par";
+
+        ifstream in(par_file);
+        if (in.fail()) {
+            throw runtime_error("Failed to open file.");
+        }
+        ofstream out(round_par_file);
+        string line;
+        while (getline(in, line)) {
+            if (line.starts_with("PROBLEM_FILE") ||
+                line.starts_with("TOUR_FILE")) {
+                continue;
+            }
+            out << line << "\n";
+        }
+        out << "PROBLEM_FILE = /dev/stdin\n";
+        out << "TOUR_FILE = " << tour_file << "\n";
+        out.close();
+
+        int fds[2];
+        if (pipe(fds) != 0) {
+            throw runtime_error("Failed to create a pipe.");
+        }
+        pid = fork();
+        if (pid == 0) {
+            // LKH のログで標準出力の JSON が崩れないようにする
+            dup2(fds[0], STDIN_FILENO);
+            dup2(STDERR_FILENO, STDOUT_FILENO);
+            close(fds[0]);
+            close(fds[1]);
+            execl(lkh_file.c_str(), lkh_file.c_str(), round_par_file.c_str(),
+                  nullptr);
+            _exit(127);
+        }
+        close(fds[0]);
+        if (pid < 0) {
+            close(fds[1]);
+            throw runtime_error("Failed to start LKH.");
+        }
+        fd = fds[1];
+    }
+
+    // LKH が先に終了していたら以降の書き込みは捨てる
+    void write(const string &s) { ok = ok && writeAll(fd, s); }
+
+    // 入力を閉じて LKH の終了を待ち、ツアーを読む
+    vector<int> finish() {
+        close(fd);
+        int status;
+        waitpid(pid, &status, 0);
+        vector<int> tour;
+        if (ok && WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            tour = readTour(tour_file);
+        }
+        remove(tour_file.c_str());
+        remove(round_par_file.c_str());
+        rmdir(dir.c_str());
+        return tour;
+    }
+
+  private:
+    string dir;
+    string tour_file;
+    string round_par_file;
+    pid_t pid;
+    int fd;
+    bool ok = true;
+};
+
+// 最近傍法で初期ツアーを作る
+vector<int> buildInitialTour(const vector<vector<int>> &cost) {
+    const int N = cost.size();
+    vector<int> tour;
+    vector<bool> visited(N, false);
+    for (int current = 0; (int)tour.size() < N;) {
+        tour.push_back(current);
+        visited[current] = true;
+        int best = -1;
+        for (int next = 0; next < N; ++next) {
+            if (visited[next] || cost[current][next] < 0) {
+                continue;
+            }
+            if (best == -1 || cost[current][next] < cost[current][best]) {
+                best = next;
+            }
+        }
+        if (best == -1) {
+            best = find(visited.begin(), visited.end(), false) -
+                   visited.begin();
+        }
+        current = best;
+    }
+    return tour;
+}
+
+int main(int argc, char *argv[]) {
+    // --lkh を指定しなければ局所探索で解く。--dump を指定したときだけ
+    // 中間ファイルを書き出す
+    string lkh_file, par_file, dump_dir;
+    while (argc >= 3) {
+        string option{argv[1]};
+        if (option == "--lkh" && argc >= 4) {
+            lkh_file = argv[2];
+            par_file = argv[3];
+            argc -= 3;
+            argv += 3;
+        } else if (option == "--dump") {
+            dump_dir = argv[2];
+            argc -= 2;
+            argv += 2;
+        } else {
+            break;
+        }
+    }
+    if (argc != 3) {
+        cerr << "Usage: ./pipeline [--lkh <lkh> <par_file>] [--dump "
+                "<output_dir>] <station_file> <join_file>"
+             << endl;
+        return -1;
+    }
+
+    string station_file{argv[1]};
+    string join_file{argv[2]};
+
+    vector<Station> stations = readStations(station_file);
+    StationRepository stationRepository(stations);
+
+    // 接続は 1 度だけ読み、グラフ用に残しながらグループを作る
+    vector<Join> joins;
+    StationGrouper grouper(stations);
+    forEachJoin(join_file, [&](const Join &join) {
+        joins.push_back(join);
+        grouper.addJoin(join);
+    });
+    vector<Group> groups = grouper.getGroups();
+    GroupRepository groupRepository(groups);
+
+    NodeRepository nodeRepository;
+    Graph graph(&nodeRepository);
+    buildGraph(
+        stations, stationRepository, joins,
+        [&](int code) { return groupRepository.isSame(code, TOKYO); },
+        nodeRepository, graph);
+
+    const int N = graph.getNodeSize();
+
+    vector<vector<double>> cost =
+        calcCost(graph, nodeRepository, stationRepository);
+
+    unique_ptr<LkhProcess> lkh;
+    if (!lkh_file.empty()) {
+        signal(SIGPIPE, SIG_IGN);
+        try {
+            lkh = make_unique<LkhProcess>(lkh_file, par_file);
+        } catch (const runtime_error &e) {
+            cerr << e.what() << endl;
+            return 1;
+        }
+    }
+    ofstream tsp_file;
+    if (!dump_dir.empty()) {
+        tsp_file.open(dump_dir + "/railway.tsp", ios::out);
+    }
+
+    // 求まった行から順に LKH とファイルへ書き出し、最短路の計算と重ねる
+    vector<vector<double>> distance(N, vector<double>(N, DBL_MAX));
+    vector<vector<int>> next(N, vector<int>(N, -1));
+    RowQueue rowQueue(N);
+    thread writer;
+    if (lkh || tsp_file.is_open()) {
+        writer = thread([&] {
+            auto emit = [&](const string &s) {
+                if (lkh) {
+                    lkh->write(s);
+                }
+                if (tsp_file.is_open()) {
+                    tsp_file << s;
+                }
+            };
+            ostringstream header;
+            writeProblemHeader(header, N);
+            emit(header.str());
+            for (int i = 0; i < N; ++i) {
+                rowQueue.wait(i);
+                emit(formatProblemRow(distance[i], N));
+            }
+            ostringstream footer;
+            writeProblemFooter(footer);
+            emit(footer.str());
+        });
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < N; ++i) {
+        dijkstra(i, graph, cost, distance, next);
+        rowQueue.push(i);
+    }
+    if (writer.joinable()) {
+        writer.join();
+    }
+    vector<vector<double>>().swap(cost);
+
+    vector<int> tour;
+    if (lkh) {
+        tour = lkh->finish();
+    } else {
+        vector<vector<int>> problem(N, vector<int>(N));
+#pragma omp parallel for
+        for (int i = 0; i < N; ++i) {
+            for (int j = 0; j < N; ++j) {
+                problem[i][j] =
+                    distance[i][j] == DBL_MAX ? -1 : lround(distance[i][j]);
+            }
+        }
+        LocalSearch localSearch(problem, NEIGHBOR_SIZE);
+        vector<int> active(N);
+        iota(active.begin(), active.end(), 0);
+        tour = localSearch.improve(buildInitialTour(problem), active,
+                                   MAX_MOVES);
+    }
+    if ((int)tour.size() != N) {
+        cerr << "Failed to solve." << endl;
+        return 1;
+    }
+
+    if (!dump_dir.empty()) {
+        ofstream group_file;
+        group_file.open(dump_dir + "/group.csv", ios::out);
+        group_file << "station_cd,leader\n";
+        for (const Group &group : groups) {
+            group_file << group.station_code << "," << group.leader << "\n";
+        }
+
+        AsyncWriter path_writer(dump_dir + "/shortest_path.csv");
+        ostream distance_file(&path_writer);
+        writeShortestPath(distance_file, next);
+        if (!path_writer.close()) {
+            cerr << "Failed to write file." << endl;
+            return 1;
+        }
+
+        ofstream path_file;
+        path_file.open(dump_dir + "/shortest_path.bin", ios::out | ios::binary);
+        CompressedPathRepository(N, N, [&](int from, int to) {
+            return next[from][to];
+        }).write(path_file);
+        path_file.close();
+        if (path_file.fail()) {
+            cerr << "Failed to write file." << endl;
+            return 1;
+        }
+
+        ofstream node_file;
+        node_file.open(dump_dir + "/node.csv", ios::out);
+        writeNode(node_file, nodeRepository);
+
+        long long length = 0;
+        for (int i = 0; i < N; ++i) {
+            length += lround(distance[tour[i]][tour[(i + 1) % N]]);
+        }
+        ofstream tour_file;
+        tour_file.open(dump_dir + "/railway.lkh", ios::out);
+        writeTour(tour_file, tour, length, lkh ? "LKH" : "pipeline");
+    }
+
+    vector<int> station_codes = expandTour(
+        tour, nodeRepository, [&](int from, int to) { return next[from][to]; });
+
+    json j;
+    j["tour"] = json::array();
+    for (int code : station_codes) {
+        j["tour"].push_back({
+            {"station_code", code},
+        });
+    }
+    cout << j << endl;
+
+    return 0;
+}
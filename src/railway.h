@@ -1,11 +1,32 @@
+#include <algorithm>
+#include <atcoder/dsu>
+#include <bit>
+#include <cfloat>
+#include <climits>
 #include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fcntl.h>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <queue>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -16,18 +37,56 @@ const double EQUATOR_RADIUS = 6378137.0;
 const double E2 =
     (POLE_RADIUS * POLE_RADIUS - EQUATOR_RADIUS * EQUATOR_RADIUS) /
     (POLE_RADIUS * POLE_RADIUS);
+const int WRITE_CHUNK_SIZE = 1024;
+
+// 駅の文字列を大きなチャンクにまとめて保持する。同じ文字列は一度だけ持つ
+class StringArena {
+  public:
+    std::string_view intern(std::string_view s) {
+        auto it = interned.find(s);
+        if (it != interned.end()) {
+            return *it;
+        }
+        if (chunks.empty() || used + s.size() > capacity) {
+            capacity = std::max(CHUNK_SIZE, s.size());
+            chunks.push_back(std::make_unique<char[]>(capacity));
+            used = 0;
+        }
+        char *data = chunks.back().get() + used;
+        std::copy(s.begin(), s.end(), data);
+        used += s.size();
+
+        std::string_view view(data, s.size());
+        interned.insert(view);
+        return view;
+    }
+
+  private:
+    static constexpr size_t CHUNK_SIZE = 1 << 16;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t used = 0;
+    size_t capacity = 0;
+    std::unordered_set<std::string_view> interned;
+};
+
+// 駅の文字列はプロセスが終わるまで保持する
+StringArena &getStationArena() {
+    static StringArena arena;
+    return arena;
+}
 
 struct Station {
     int station_code;
     int station_group_code;
-    std::string station_name;
     int line_code;
     int prefecture_code;
-    std::string post;
-    std::string address;
     double lon;
     double lat;
+    std::string_view station_name;
+    std::string_view post;
+    std::string_view address;
 };
+static_assert(std::is_trivially_copyable_v<Station>);
 
 struct Join {
     int line_code;
@@ -94,8 +153,9 @@ class StationRepository {
 
 class NodeRepository {
   public:
+    // 同じ駅に複数のノードがあるときは最初のノードを駅のノードとする
     void addNode(Node node) {
-        station_code_to_node[node.station_code] = node;
+        station_code_to_node.emplace(node.station_code, node);
         node_id_to_node[node.node_id] = node;
     }
 
@@ -149,6 +209,91 @@ class Graph {
     std::map<int, std::set<int>> neighbors;
 };
 
+// isTarget を満たす駅について、接続と同じ駅グループ内の乗り換えを辺とする
+void buildGraph(const std::vector<Station> &stations,
+                const StationRepository &stationRepository,
+                const std::vector<Join> &joins,
+                std::function<bool(int)> isTarget,
+                NodeRepository &nodeRepository, Graph &graph) {
+    for (const Join &join : joins) {
+        if (!stationRepository.getStationByCode(join.station_code1)) {
+            continue;
+        }
+        if (!stationRepository.getStationByCode(join.station_code2)) {
+            continue;
+        }
+
+        Station station1 =
+            stationRepository.getStationByCode(join.station_code1).value();
+        Station station2 =
+            stationRepository.getStationByCode(join.station_code2).value();
+
+        if (!nodeRepository.getNodeByStationCode(station1.station_code)) {
+            if (!isTarget(station1.station_code)) {
+                continue;
+            }
+            int id = nodeRepository.size();
+            Node node{id, station1.station_code};
+            nodeRepository.addNode(node);
+        }
+        if (!nodeRepository.getNodeByStationCode(station2.station_code)) {
+            if (!isTarget(station2.station_code)) {
+                continue;
+            }
+            int id = nodeRepository.size();
+            Node node{id, station2.station_code};
+            nodeRepository.addNode(node);
+        }
+
+        Node node1 =
+            nodeRepository.getNodeByStationCode(station1.station_code).value();
+        Node node2 =
+            nodeRepository.getNodeByStationCode(station2.station_code).value();
+        graph.addEdge(node1, node2);
+    }
+
+    std::set<int> station_group_codes;
+    for (const Station &station : stations) {
+        if (!nodeRepository.getNodeByStationCode(station.station_code)) {
+            continue;
+        }
+        if (!isTarget(station.station_code)) {
+            continue;
+        }
+        station_group_codes.insert(station.station_group_code);
+    }
+    for (int code : station_group_codes) {
+        std::vector<Station> stations =
+            stationRepository.getStationsByStationGroupCode(code);
+        if (stations.size() <= 1) {
+            continue;
+        }
+        for (int i = 0; i < (int)stations.size(); ++i) {
+            Station station1 = stations[i];
+            if (!nodeRepository.getNodeByStationCode(station1.station_code)) {
+                continue;
+            }
+            Node node1 =
+                nodeRepository.getNodeByStationCode(station1.station_code)
+                    .value();
+            for (int j = 0; j < (int)stations.size(); ++j) {
+                if (i == j) {
+                    continue;
+                }
+                Station station2 = stations[j];
+                if (!nodeRepository.getNodeByStationCode(
+                        station2.station_code)) {
+                    continue;
+                }
+                Node node2 =
+                    nodeRepository.getNodeByStationCode(station2.station_code)
+                        .value();
+                graph.addEdge(node1, node2);
+            }
+        }
+    }
+}
+
 class GroupRepository {
   public:
     explicit GroupRepository(const std::vector<Group> &groups) {
@@ -168,6 +313,77 @@ class GroupRepository {
     std::map<int, int> mp;
 };
 
+// 接続でつながる駅と同じ駅グループの駅を 1 つのグループにまとめる。
+// 接続は addJoin で 1 件ずつ渡し、最後に一度だけ getGroups を呼ぶ。
+class StationGrouper {
+  public:
+    explicit StationGrouper(const std::vector<Station> &stations)
+        : stations(stations), d(stations.size()) {
+        for (const Station &station : stations) {
+            station_codes_in_file.insert(station.station_code);
+        }
+    }
+
+    void addJoin(const Join &join) {
+        if (station_codes_in_file.count(join.station_code1) == 0) {
+            return;
+        }
+        if (station_codes_in_file.count(join.station_code2) == 0) {
+            return;
+        }
+        int node1 = getNodeId(join.station_code1);
+        int node2 = getNodeId(join.station_code2);
+        d.merge(node1, node2);
+    }
+
+    // 接続に現れた駅だけを、現れた順に返す
+    std::vector<Group> getGroups() {
+        // 同じ駅グループの駅は代表の 1 駅とだけつなげば連結性は変わらない
+        std::unordered_map<int, int> group_code_to_node_id;
+        for (const Station &station : stations) {
+            auto it = station_code_to_node_id.find(station.station_code);
+            if (it == station_code_to_node_id.end()) {
+                continue;
+            }
+            auto [first, inserted] = group_code_to_node_id.try_emplace(
+                station.station_group_code, it->second);
+            if (!inserted) {
+                d.merge(first->second, it->second);
+            }
+        }
+
+        // リーダーは連結成分で最初に現れた駅とする
+        const int N = station_codes.size();
+        std::vector<int> first(N, -1);
+        std::vector<Group> groups;
+        for (int i = 0; i < N; ++i) {
+            int leader = d.leader(i);
+            if (first[leader] == -1) {
+                first[leader] = i;
+            }
+            groups.push_back({station_codes[i], station_codes[first[leader]]});
+        }
+        return groups;
+    }
+
+  private:
+    const std::vector<Station> &stations;
+    atcoder::dsu d;
+    std::unordered_set<int> station_codes_in_file;
+    std::vector<int> station_codes;
+    std::unordered_map<int, int> station_code_to_node_id;
+
+    // 接続に現れた駅だけにノード ID を振る
+    int getNodeId(int code) {
+        auto [it, inserted] =
+            station_code_to_node_id.try_emplace(code, station_codes.size());
+        if (inserted) {
+            station_codes.push_back(code);
+        }
+        return it->second;
+    }
+};
+
 class Prefectures {
   public:
     std::string getPrefectureNameById(int id) const {
@@ -205,6 +421,185 @@ double calcDistance(Coordinate a, Coordinate b) {
     return distance_meter / 1000.0;
 }
 
+struct NearStation {
+    Station station;
+    double distance;
+};
+
+// 駅の緯度経度に対する k-d 木
+class StationIndex {
+  public:
+    explicit StationIndex(const std::vector<Station> &stations)
+        : stations(stations) {
+        std::vector<int> order(stations.size());
+        for (int i = 0; i < (int)order.size(); ++i) {
+            order[i] = i;
+        }
+        root = build(order, 0, order.size());
+    }
+
+    std::vector<NearStation> getNearestStations(Coordinate c, int k) const {
+        return search(c, k, -1);
+    }
+
+    std::vector<NearStation> getStationsWithin(Coordinate c,
+                                               double radius) const {
+        return search(c, -1, radius);
+    }
+
+    // k 駅まで、radius km 以内の駅を近い順に返す。-1 は制限なし
+    std::vector<NearStation> search(Coordinate c, int k,
+                                    double radius) const {
+        std::vector<NearStation> result;
+        if (k == 0) {
+            return result;
+        }
+        visit(root, c, k, radius, result);
+        std::sort_heap(result.begin(), result.end(), isCloser);
+        return result;
+    }
+
+    std::vector<std::vector<NearStation>>
+    search(const std::vector<Coordinate> &coordinates, int k,
+           double radius) const {
+        std::vector<std::vector<NearStation>> results(coordinates.size());
+#pragma omp parallel for schedule(dynamic, 64)
+        for (int i = 0; i < (int)coordinates.size(); ++i) {
+            results[i] = search(coordinates[i], k, radius);
+        }
+        return results;
+    }
+
+  private:
+    struct KdNode {
+        int station;
+        int left;
+        int right;
+        double lat_min;
+        double lat_max;
+        double lon_min;
+        double lon_max;
+    };
+
+    std::vector<Station> stations;
+    std::vector<KdNode> nodes;
+    int root;
+
+    static bool isCloser(const NearStation &a, const NearStation &b) {
+        if (a.distance != b.distance) {
+            return a.distance < b.distance;
+        }
+        return a.station.station_code < b.station.station_code;
+    }
+
+    int build(std::vector<int> &order, int lo, int hi) {
+        if (lo >= hi) {
+            return -1;
+        }
+        KdNode node{-1, -1, -1, DBL_MAX, -DBL_MAX, DBL_MAX, -DBL_MAX};
+        for (int i = lo; i < hi; ++i) {
+            const Station &station = stations[order[i]];
+            node.lat_min = std::min(node.lat_min, station.lat);
+            node.lat_max = std::max(node.lat_max, station.lat);
+            node.lon_min = std::min(node.lon_min, station.lon);
+            node.lon_max = std::max(node.lon_max, station.lon);
+        }
+
+        // 広がりの大きい軸で分割する
+        bool by_lat =
+            node.lat_max - node.lat_min >= node.lon_max - node.lon_min;
+        int mid = (lo + hi) / 2;
+        std::nth_element(order.begin() + lo, order.begin() + mid,
+                         order.begin() + hi, [&](int a, int b) {
+                             return by_lat ? stations[a].lat < stations[b].lat
+                                           : stations[a].lon < stations[b].lon;
+                         });
+        node.station = order[mid];
+
+        int id = nodes.size();
+        nodes.push_back(node);
+        int left = build(order, lo, mid);
+        int right = build(order, mid + 1, hi);
+        nodes[id].left = left;
+        nodes[id].right = right;
+        return id;
+    }
+
+    // 部分木のどの駅に対しても calcDistance 以下になる距離
+    static double calcLowerBound(Coordinate c, const KdNode &node) {
+        double Dx =
+            std::max({node.lat_min - c.lat, c.lat - node.lat_max, 0.0}) *
+            M_PI / 180.0;
+        double Dy =
+            std::max({node.lon_min - c.lon, c.lon - node.lon_max, 0.0}) *
+            M_PI / 180.0;
+        if (Dx == 0 && Dy == 0) {
+            return 0;
+        }
+
+        // M と N cos(P) は |P| について単調なので端点で最小になる
+        double P1 = (c.lat + node.lat_min) / 2.0 * M_PI / 180.0;
+        double P2 = (c.lat + node.lat_max) / 2.0 * M_PI / 180.0;
+        double lo = P1 <= 0 && 0 <= P2 ? 0 : std::min(fabs(P1), fabs(P2));
+        double hi = std::max(fabs(P1), fabs(P2));
+        auto calcM = [](double P) {
+            double W = sqrt(1 - E2 * pow(sin(P), 2));
+            return POLE_RADIUS * (1 - E2) / pow(W, 3);
+        };
+        auto calcNcosP = [](double P) {
+            double W = sqrt(1 - E2 * pow(sin(P), 2));
+            return POLE_RADIUS / W * cos(P);
+        };
+        double M = std::min(calcM(lo), calcM(hi));
+        double NcosP = std::min(calcNcosP(lo), calcNcosP(hi));
+        double distance_meter = sqrt(pow(Dx * M, 2) + pow(Dy * NcosP, 2));
+        // 丸め誤差で枝刈りしすぎないよう少し小さくする
+        return distance_meter / 1000.0 * (1 - 1e-9);
+    }
+
+    void visit(int id, Coordinate c, int k, double radius,
+               std::vector<NearStation> &heap) const {
+        if (id == -1) {
+            return;
+        }
+        const KdNode &node = nodes[id];
+        auto limit = [&]() {
+            double bound = radius < 0 ? DBL_MAX : radius;
+            if (k > 0 && (int)heap.size() == k) {
+                bound = std::min(bound, heap.front().distance);
+            }
+            return bound;
+        };
+        if (calcLowerBound(c, node) > limit()) {
+            return;
+        }
+
+        const Station &station = stations[node.station];
+        NearStation near{station,
+                         calcDistance(c, {station.lat, station.lon})};
+        if (radius < 0 || near.distance <= radius) {
+            if (k < 0 || (int)heap.size() < k) {
+                heap.push_back(near);
+                std::push_heap(heap.begin(), heap.end(), isCloser);
+            } else if (isCloser(near, heap.front())) {
+                std::pop_heap(heap.begin(), heap.end(), isCloser);
+                heap.back() = near;
+                std::push_heap(heap.begin(), heap.end(), isCloser);
+            }
+        }
+
+        int first = node.left;
+        int second = node.right;
+        if (second != -1 &&
+            (first == -1 || calcLowerBound(c, nodes[second]) <
+                                calcLowerBound(c, nodes[first]))) {
+            std::swap(first, second);
+        }
+        visit(first, c, k, radius, heap);
+        visit(second, c, k, radius, heap);
+    }
+};
+
 class PathRepository {
   public:
     explicit PathRepository(const std::vector<Path> &paths) {
@@ -219,6 +614,1095 @@ class PathRepository {
     std::map<int, std::map<int, int>> mp;
 };
 
+std::vector<std::vector<double>>
+calcCost(const Graph &graph, const NodeRepository &nodeRepository,
+         const StationRepository &stationRepository) {
+    const int N = graph.getNodeSize();
+    std::vector<std::vector<double>> cost(N, std::vector<double>(N, DBL_MAX));
+    std::set<Edge> edges = graph.getEdges();
+    for (const Edge &edge : edges) {
+        auto [from, to] = edge;
+
+        Node node1 = nodeRepository.getNodeById(from).value();
+        Station station1 =
+            stationRepository.getStationByCode(node1.station_code).value();
+        Node node2 = nodeRepository.getNodeById(to).value();
+        Station station2 =
+            stationRepository.getStationByCode(node2.station_code).value();
+
+        double distance = calcDistance({station1.lat, station1.lon},
+                                       {station2.lat, station2.lon});
+        cost[from][to] = distance;
+        cost[to][from] = distance;
+    }
+    return cost;
+}
+
+// 始点 i からの距離を distance[i] に、各駅から i へ向かう次の駅を
+// next[*][i] に書く。距離が同じ路は辺の少ない方を選び、それでも並べば
+// 番号の小さい駅を次の駅にするので、木は取り出す順序によらず決まる
+void dijkstra(int i, const Graph &graph,
+              const std::vector<std::vector<double>> &cost,
+              std::vector<std::vector<double>> &distance,
+              std::vector<std::vector<int>> &next) {
+    std::vector<int> hops(distance.size(), INT_MAX);
+    distance[i][i] = 0;
+    hops[i] = 0;
+    std::priority_queue<std::tuple<double, int, int>,
+                        std::vector<std::tuple<double, int, int>>,
+                        std::greater<std::tuple<double, int, int>>>
+        pq;
+    pq.push({0, 0, i});
+    while (!pq.empty()) {
+        auto [d, h, current] = pq.top();
+        pq.pop();
+        if (std::tie(d, h) > std::tie(distance[i][current], hops[current])) {
+            continue;
+        }
+        for (int neighbor : graph.getNeighbors(current)) {
+            auto key = std::make_pair(d + cost[current][neighbor], h + 1);
+            auto label = std::make_pair(distance[i][neighbor], hops[neighbor]);
+            if (key < label) {
+                distance[i][neighbor] = key.first;
+                hops[neighbor] = key.second;
+                pq.push({key.first, key.second, neighbor});
+                next[neighbor][i] = current;
+            } else if (key == label && current < next[neighbor][i]) {
+                next[neighbor][i] = current;
+            }
+        }
+    }
+}
+
+// Floyd-Warshall の 1 行分の min-plus 更新。x86-64 では実行時に CPU が
+// 対応している AVX-512 か AVX2 の版が選ばれ、どちらもなければ SSE2 の版になる
+#if defined(__x86_64__)
+__attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+void relaxRow(double *__restrict di, const double *__restrict dk, double dik,
+              int len) {
+#pragma omp simd
+    for (int j = 0; j < len; ++j) {
+        di[j] = std::min(di[j], dik + dk[j]);
+    }
+}
+
+// 全点対最短路の距離をタイルに分けた Floyd-Warshall で求め、次の駅は
+// 最短路に乗る辺だけのグラフから復元する。結果は dijkstra を全始点で
+// 呼んだときと同じになる。
+class FloydWarshall {
+  public:
+    static constexpr int TILE_SIZE = 64;
+
+    FloydWarshall(const Graph &graph,
+                  const std::vector<std::vector<double>> &cost)
+        : N(graph.getNodeSize()),
+          P((N + TILE_SIZE - 1) / TILE_SIZE * TILE_SIZE),
+          d((size_t)P * P, DBL_MAX), neighbors(N) {
+        for (int i = 0; i < N; ++i) {
+            d[(size_t)i * P + i] = 0;
+            for (int j : graph.getNeighbors(i)) {
+                d[(size_t)i * P + j] = cost[i][j];
+                neighbors[i].push_back({j, cost[i][j]});
+            }
+        }
+    }
+
+    void solve(std::vector<std::vector<double>> &distance,
+               std::vector<std::vector<int>> &next) {
+        const int T = P / TILE_SIZE;
+        for (int k = 0; k < T; ++k) {
+            relaxTile(k, k, k);
+#pragma omp parallel for
+            for (int t = 0; t < T; ++t) {
+                if (t != k) {
+                    relaxTile(k, t, k);
+                    relaxTile(t, k, k);
+                }
+            }
+#pragma omp parallel for collapse(2)
+            for (int i = 0; i < T; ++i) {
+                for (int j = 0; j < T; ++j) {
+                    if (i != k && j != k) {
+                        relaxTile(i, j, k);
+                    }
+                }
+            }
+        }
+
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < N; ++i) {
+            traceTree(i, distance, next);
+        }
+    }
+
+    // 密なグラフでは N 回の dijkstra より演算量が少なくなる。traceTree も
+    // 始点ごとに全ての辺を見るが、キューに入るのは最短路に乗る辺だけになる
+    static bool isFaster(const Graph &graph) {
+        const double N = graph.getNodeSize();
+        const double E = graph.getEdges().size();
+        const double log_N = std::log2(N + 1);
+        double floyd = N * N * N / SIMD_WIDTH + N * (2 * E + N * log_N);
+        double dijkstra = N * (2 * E + N) * log_N;
+        return floyd < dijkstra;
+    }
+
+  private:
+    static constexpr int SIMD_WIDTH = 4;
+    static constexpr double TOLERANCE = 1e-9;
+
+    const int N;
+    const int P;
+    std::vector<double> d;
+    std::vector<std::vector<std::pair<int, double>>> neighbors;
+
+    // 最短路に乗る辺だけで dijkstra と同じ規則の木を作り、距離も同じ順に
+    // 足し直して一致させる。誤差を見込んで少し長い辺も残すが、そのような
+    // 辺は親にならない
+    void traceTree(int i, std::vector<std::vector<double>> &distance,
+                   std::vector<std::vector<int>> &next) const {
+        const double *di = &d[(size_t)i * P];
+        std::vector<int> hops(N, INT_MAX);
+        distance[i][i] = 0;
+        hops[i] = 0;
+        std::priority_queue<std::tuple<double, int, int>,
+                            std::vector<std::tuple<double, int, int>>,
+                            std::greater<std::tuple<double, int, int>>>
+            pq;
+        pq.push({0, 0, i});
+        while (!pq.empty()) {
+            auto [du, hu, u] = pq.top();
+            pq.pop();
+            if (std::tie(du, hu) > std::tie(distance[i][u], hops[u])) {
+                continue;
+            }
+            for (auto [v, c] : neighbors[u]) {
+                if (di[u] + c > di[v] + TOLERANCE * (1 + di[v])) {
+                    continue;
+                }
+                auto key = std::make_pair(du + c, hu + 1);
+                auto label = std::make_pair(distance[i][v], hops[v]);
+                if (key < label) {
+                    distance[i][v] = key.first;
+                    hops[v] = key.second;
+                    pq.push({key.first, key.second, v});
+                    next[v][i] = u;
+                } else if (key == label && u < next[v][i]) {
+                    next[v][i] = u;
+                }
+            }
+        }
+    }
+
+    // タイル (ti, tj) を、タイル tk の頂点を経由する路で更新する
+    void relaxTile(int ti, int tj, int tk) {
+        for (int k = tk * TILE_SIZE; k < (tk + 1) * TILE_SIZE; ++k) {
+            const double *dk = &d[(size_t)k * P + tj * TILE_SIZE];
+            for (int i = ti * TILE_SIZE; i < (ti + 1) * TILE_SIZE; ++i) {
+                double dik = d[(size_t)i * P + k];
+                if (i == k || dik == DBL_MAX) {
+                    continue;
+                }
+                relaxRow(&d[(size_t)i * P + tj * TILE_SIZE], dk, dik,
+                         TILE_SIZE);
+            }
+        }
+    }
+};
+
+// ツアーの隣り合うノードの間を getNext で辿り、通る駅コードを並べる。
+// 路線ごとの状態を辿るときは同じ駅が続くので 1 つにまとめる。
+std::vector<int> expandTour(const std::vector<int> &tour,
+                            const NodeRepository &nodeRepository,
+                            std::function<int(int, int)> getNext) {
+    std::vector<int> station_codes;
+    const int N = tour.size();
+    for (int i = 0; i < N; ++i) {
+        Node current_node = nodeRepository.getNodeById(tour[i]).value();
+        int to_node_id = i < N - 1 ? tour[i + 1] : tour[0];
+
+        while (current_node.node_id != to_node_id) {
+            if (station_codes.empty() ||
+                station_codes.back() != current_node.station_code) {
+                station_codes.push_back(current_node.station_code);
+            }
+            int next_node_id = getNext(current_node.node_id, to_node_id);
+            current_node = nodeRepository.getNodeById(next_node_id).value();
+        }
+    }
+    return station_codes;
+}
+
+// (駅, 路線) を頂点とする CSR 形式のグラフ。路線を乗り換えると penalty km
+// を加える。ノード ID 0..N-1 は Graph の駅で、複数の路線が通る駅は
+// 出発専用の頂点になり、路線ごとの状態に N 以降の ID を振る。
+class StateGraph {
+  public:
+    StateGraph(const Graph &graph, const StationRepository &stationRepository,
+               const std::vector<Join> &joins, double penalty)
+        : N(graph.getNodeSize()) {
+        std::map<int, int> ids;
+        for (int i = 0; i < N; ++i) {
+            station_codes.push_back(graph.getNodeById(i)->station_code);
+            ids[station_codes[i]] = i;
+        }
+
+        std::vector<std::set<int>> line_codes(N);
+        std::vector<std::tuple<int, int, int>> tracks;
+        for (const Join &join : joins) {
+            if (ids.count(join.station_code1) == 0 ||
+                ids.count(join.station_code2) == 0) {
+                continue;
+            }
+            int id1 = ids[join.station_code1];
+            int id2 = ids[join.station_code2];
+            line_codes[id1].insert(join.line_code);
+            line_codes[id2].insert(join.line_code);
+            tracks.push_back({id1, id2, join.line_code});
+        }
+
+        states.resize(N);
+        for (int i = 0; i < N; ++i) {
+            if (line_codes[i].size() <= 1) {
+                int line_code =
+                    line_codes[i].empty() ? -1 : *line_codes[i].begin();
+                states[i][line_code] = i;
+                continue;
+            }
+            for (int line_code : line_codes[i]) {
+                states[i][line_code] = station_codes.size();
+                station_codes.push_back(station_codes[i]);
+            }
+        }
+
+        std::vector<std::tuple<int, int, double>> edges;
+        auto addEdge = [&](int from, int to, double weight) {
+            edges.push_back({from, to, weight});
+            edges.push_back({to, from, weight});
+        };
+        auto getCoordinate = [&](int id) {
+            Station station =
+                stationRepository.getStationByCode(station_codes[id]).value();
+            return Coordinate{station.lat, station.lon};
+        };
+
+        for (auto [from, to, line_code] : tracks) {
+            addEdge(states[from][line_code], states[to][line_code],
+                    calcDistance(getCoordinate(from), getCoordinate(to)));
+        }
+        for (int i = 0; i < N; ++i) {
+            if (states[i].size() <= 1) {
+                continue;
+            }
+            for (auto [line_code1, state1] : states[i]) {
+                edges.push_back({i, state1, 0});
+                for (auto [line_code2, state2] : states[i]) {
+                    if (state1 < state2) {
+                        addEdge(state1, state2, penalty);
+                    }
+                }
+            }
+        }
+        for (int i = 0; i < N; ++i) {
+            Station station1 =
+                stationRepository.getStationByCode(station_codes[i]).value();
+            for (int j : graph.getNeighbors(i)) {
+                Station station2 =
+                    stationRepository.getStationByCode(station_codes[j])
+                        .value();
+                if (i > j || station1.station_group_code !=
+                                 station2.station_group_code) {
+                    continue;
+                }
+                double distance =
+                    calcDistance(getCoordinate(i), getCoordinate(j)) + penalty;
+                for (auto [line_code1, state1] : states[i]) {
+                    for (auto [line_code2, state2] : states[j]) {
+                        addEdge(state1, state2, distance);
+                    }
+                }
+            }
+        }
+
+        const int S = station_codes.size();
+        offsets.assign(S + 1, 0);
+        for (auto [from, to, weight] : edges) {
+            ++offsets[from + 1];
+        }
+        for (int i = 0; i < S; ++i) {
+            offsets[i + 1] += offsets[i];
+        }
+        targets.resize(edges.size());
+        weights.resize(edges.size());
+        std::vector<int> position(offsets.begin(), offsets.end() - 1);
+        for (auto [from, to, weight] : edges) {
+            targets[position[from]] = to;
+            weights[position[from]] = weight;
+            ++position[from];
+        }
+    }
+
+    int getNodeSize() const { return N; }
+
+    int getStateSize() const { return station_codes.size(); }
+
+    int getStationCode(int id) const { return station_codes[id]; }
+
+    // distance と parent は状態ごと。複数路線の駅は最も近い状態を親とする
+    void calcShortestPath(int source, std::vector<double> &distance,
+                          std::vector<int> &parent) const {
+        const int S = getStateSize();
+        distance.assign(S, DBL_MAX);
+        parent.assign(S, -1);
+        distance[source] = 0;
+        std::priority_queue<std::pair<double, int>,
+                            std::vector<std::pair<double, int>>,
+                            std::greater<std::pair<double, int>>>
+            pq;
+        pq.push({0, source});
+        while (!pq.empty()) {
+            auto [d, current] = pq.top();
+            pq.pop();
+            if (d > distance[current]) {
+                continue;
+            }
+            for (int k = offsets[current]; k < offsets[current + 1]; ++k) {
+                int next = targets[k];
+                if (d + weights[k] < distance[next]) {
+                    distance[next] = d + weights[k];
+                    parent[next] = current;
+                    pq.push({distance[next], next});
+                }
+            }
+        }
+
+        for (int i = 0; i < N; ++i) {
+            if (i == source || states[i].size() <= 1) {
+                continue;
+            }
+            for (auto [line_code, state] : states[i]) {
+                if (distance[state] < distance[i]) {
+                    distance[i] = distance[state];
+                    parent[i] = state;
+                }
+            }
+        }
+    }
+
+  private:
+    const int N;
+    std::vector<int> station_codes;
+    std::vector<std::map<int, int>> states;
+    std::vector<int> offsets;
+    std::vector<int> targets;
+    std::vector<double> weights;
+};
+
+// 最短路木をまとめて持つ next 行列の圧縮表現。駅 from から次に進む駅は、
+// from の行に現れる値 (グラフの隣接駅の一部) のどれかなので、その番号を
+// 数ビットで持つ。番号 0 は次の駅がないことを表す。
+// 終点 to ごとの木を 64 ビット境界にそろえて並べ、getNext は展開せずに引く。
+class CompressedPathRepository {
+  public:
+    CompressedPathRepository(int rows, int columns,
+                             std::function<int(int, int)> getNext)
+        : rows(rows), columns(columns), candidates(rows), offsets(rows + 1),
+          widths(rows) {
+#pragma omp parallel for
+        for (int from = 0; from < rows; ++from) {
+            std::vector<int> &values = candidates[from];
+            for (int to = 0; to < columns; ++to) {
+                int next = getNext(from, to);
+                if (next != -1 &&
+                    std::find(values.begin(), values.end(), next) ==
+                        values.end()) {
+                    values.push_back(next);
+                }
+            }
+            std::sort(values.begin(), values.end());
+        }
+        initLayout();
+        words.assign(tree_size / 64 * columns + 1, 0);
+
+        // 終点 64 個ずつまとめて、next 行列を行の順に読む
+#pragma omp parallel for
+        for (int block = 0; block < columns; block += 64) {
+            for (int from = 0; from < rows; ++from) {
+                for (int to = block; to < std::min(block + 64, columns); ++to) {
+                    int next = getNext(from, to);
+                    int slot = 0;
+                    if (next != -1) {
+                        slot = std::lower_bound(candidates[from].begin(),
+                                                candidates[from].end(), next) -
+                               candidates[from].begin() + 1;
+                    }
+                    setBits(getPosition(from, to), widths[from], slot);
+                }
+            }
+        }
+    }
+
+    // 読み込みに失敗したり、ファイルが途中で切れていたり、候補にない番号を
+    // 含んでいれば例外を投げる。確保する前に大きさを残りのバイト数と比べる
+    explicit CompressedPathRepository(std::istream &is) {
+        uint64_t remaining = getRemainingSize(is);
+        readValue(is, rows);
+        readValue(is, columns);
+        if (!is || rows < 0 || columns < 0 ||
+            (uint64_t)rows * sizeof(int) > remaining) {
+            throw std::runtime_error("Invalid shortest path file.");
+        }
+        candidates.resize(rows);
+        offsets.resize(rows + 1);
+        widths.resize(rows);
+        for (int from = 0; from < rows; ++from) {
+            int size;
+            readValue(is, size);
+            if (!is || size < 0 || size > rows) {
+                throw std::runtime_error("Invalid shortest path file.");
+            }
+            candidates[from].resize(size);
+            is.read(reinterpret_cast<char *>(candidates[from].data()),
+                    size * sizeof(int));
+            for (int next : candidates[from]) {
+                if (next < 0 || next >= rows) {
+                    throw std::runtime_error("Invalid shortest path file.");
+                }
+            }
+        }
+        initLayout();
+        uint64_t max_words = remaining / sizeof(uint64_t);
+        if (tree_size / 64 > max_words / std::max(columns, 1)) {
+            throw std::runtime_error("Invalid shortest path file.");
+        }
+        words.assign(tree_size / 64 * columns + 1, 0);
+        is.read(reinterpret_cast<char *>(words.data()),
+                words.size() * sizeof(uint64_t));
+        if (!is || !hasValidSlots()) {
+            throw std::runtime_error("Invalid shortest path file.");
+        }
+    }
+
+    int getRows() const { return rows; }
+
+    int getColumns() const { return columns; }
+
+    int getNext(int from, int to) const {
+        int slot = getBits(getPosition(from, to), widths[from]);
+        return slot == 0 ? -1 : candidates[from][slot - 1];
+    }
+
+    void write(std::ostream &os) const {
+        writeValue(os, rows);
+        writeValue(os, columns);
+        for (const std::vector<int> &values : candidates) {
+            writeValue(os, (int)values.size());
+            os.write(reinterpret_cast<const char *>(values.data()),
+                     values.size() * sizeof(int));
+        }
+        os.write(reinterpret_cast<const char *>(words.data()),
+                 words.size() * sizeof(uint64_t));
+    }
+
+  private:
+    int rows = 0;
+    int columns = 0;
+    std::vector<std::vector<int>> candidates;
+    std::vector<uint64_t> offsets;
+    std::vector<int> widths;
+    uint64_t tree_size = 0;
+    std::vector<uint64_t> words;
+
+    void initLayout() {
+        offsets[0] = 0;
+        for (int from = 0; from < rows; ++from) {
+            widths[from] = std::bit_width(candidates[from].size());
+            offsets[from + 1] = offsets[from] + widths[from];
+        }
+        tree_size = (offsets[rows] + 63) / 64 * 64;
+    }
+
+    // 番号は候補の数より大きくなりうるので、読み込んだ木をすべて確かめる。
+    // 候補の数が 2^幅 - 1 の行は範囲を超えないので飛ばす
+    bool hasValidSlots() const {
+        std::vector<int> checked;
+        for (int from = 0; from < rows; ++from) {
+            if ((1 << widths[from]) - 1 > (int)candidates[from].size()) {
+                checked.push_back(from);
+            }
+        }
+        bool valid = true;
+#pragma omp parallel for reduction(&& : valid)
+        for (int to = 0; to < columns; ++to) {
+            for (int from : checked) {
+                valid = valid && getBits(getPosition(from, to), widths[from]) <=
+                                     (int)candidates[from].size();
+            }
+        }
+        return valid;
+    }
+
+    uint64_t getPosition(int from, int to) const {
+        return tree_size * to + offsets[from];
+    }
+
+    int getBits(uint64_t position, int width) const {
+        if (width == 0) {
+            return 0;
+        }
+        uint64_t index = position / 64;
+        int shift = position % 64;
+        uint64_t value = words[index] >> shift;
+        if (shift + width > 64) {
+            value |= words[index + 1] << (64 - shift);
+        }
+        return value & ((1ULL << width) - 1);
+    }
+
+    void setBits(uint64_t position, int width, uint64_t value) {
+        if (width == 0) {
+            return;
+        }
+        uint64_t index = position / 64;
+        int shift = position % 64;
+        words[index] |= value << shift;
+        if (shift + width > 64) {
+            words[index + 1] |= value >> (64 - shift);
+        }
+    }
+
+    static uint64_t getRemainingSize(std::istream &is) {
+        std::istream::pos_type current = is.tellg();
+        if (current == -1) {
+            return UINT64_MAX;
+        }
+        is.seekg(0, std::ios::end);
+        std::istream::pos_type end = is.tellg();
+        is.clear();
+        is.seekg(current);
+        return end == -1 ? UINT64_MAX : (uint64_t)(end - current);
+    }
+
+    template <class T> static void readValue(std::istream &is, T &value) {
+        is.read(reinterpret_cast<char *>(&value), sizeof(T));
+    }
+
+    template <class T>
+    static void writeValue(std::ostream &os, const T &value) {
+        os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+};
+
+struct MinKey {
+    double key;
+    int id;
+};
+
+#pragma omp declare reduction(minKey:MinKey                                    \
+                              : omp_out = (omp_in.key < omp_out.key ||         \
+                                           (omp_in.key == omp_out.key &&       \
+                                            omp_in.id < omp_out.id))           \
+                                              ? omp_in                         \
+                                              : omp_out)                       \
+    initializer(omp_priv = {DBL_MAX, -1})
+
+// 劣勾配法による Held-Karp (1-tree) 下界。上昇法は各ノードの近い
+// candidate_size 個と全体の 1-tree の辺だけからなる疎なグラフで行い、
+// 求まった pi で全体の 1-tree を作り直して下界とする。疎なグラフの 1-tree は
+// 全体のものより重くなりうるので、そのままでは下界にならない
+class HeldKarp {
+  public:
+    HeldKarp(const std::vector<std::vector<int>> &cost, int candidate_size)
+        : cost(cost), N(cost.size()), candidate_size(candidate_size) {}
+
+    // pi を初期値として上昇法を行い、下界が最大になったときの pi を残す。
+    // 疎なグラフを作り直すたびに max_iterations 回まで上昇法を行い、
+    // 下界が target 以上になるか、0.1% も改善しなくなれば打ち切る
+    double calcLowerBound(double target, int max_iterations,
+                          std::vector<double> &pi) const {
+        if (N <= 1) {
+            return 0;
+        }
+        if (N == 2) {
+            return cost[0][1] + cost[1][0];
+        }
+
+        std::vector<int> degree(N);
+        std::vector<int> parent(N);
+        double best = calcBound(pi, degree, parent);
+        std::vector<double> best_pi = pi;
+        while (max_iterations > 1 && best < target && calcNorm(degree) != 0) {
+            std::vector<std::vector<int>> candidates =
+                buildCandidates(pi, parent);
+            ascend(target, max_iterations, pi, [&](std::vector<int> &degree) {
+                return calcSparseBound(pi, degree, candidates);
+            });
+            double bound = calcBound(pi, degree, parent);
+            bool converged = bound < best * 1.001;
+            if (bound > best) {
+                best = bound;
+                best_pi = pi;
+            }
+            if (converged) {
+                break;
+            }
+        }
+
+        pi = best_pi;
+        return best;
+    }
+
+  private:
+    const std::vector<std::vector<int>> &cost;
+    const int N;
+    const int candidate_size;
+
+    // LKH と同じく、改善する間は歩幅を倍にし、周期ごとに半分にする。
+    // 最初の歩幅は 1-tree の辺の平均の 1% で、その 1/1000 を下回れば止める
+    template <class F>
+    void ascend(double target, int max_iterations, std::vector<double> &pi,
+                F calc) const {
+        std::vector<int> degree(N);
+        double best = calc(degree);
+        std::vector<double> best_pi = pi;
+        const double initial_step = 0.01 * best / N;
+        double step = initial_step;
+        bool initial_phase = true;
+        std::vector<int> last_direction(N, 0);
+        const int initial_period = std::max(max_iterations / 4, 1);
+        int iteration = 1;
+        for (int period = initial_period;
+             period > 0 && step > initial_step * 1e-3 &&
+             iteration < max_iterations;
+             period /= 2, step /= 2) {
+            for (int p = 1; p <= period && iteration < max_iterations; ++p) {
+                // 1-tree がツアーになっているか目標に届いたら終わる
+                if (best >= target || calcNorm(degree) == 0) {
+                    pi = best_pi;
+                    return;
+                }
+                for (int i = 0; i < N; ++i) {
+                    int direction = degree[i] - 2;
+                    pi[i] += step * (0.7 * direction + 0.3 * last_direction[i]);
+                    last_direction[i] = direction;
+                }
+                double bound = calc(degree);
+                ++iteration;
+                if (bound > best) {
+                    best = bound;
+                    best_pi = pi;
+                    if (initial_phase) {
+                        step *= 2;
+                    }
+                    if (p == period) {
+                        period = std::min(period * 2, initial_period);
+                    }
+                } else if (initial_phase && p > period / 2) {
+                    initial_phase = false;
+                    p = 0;
+                    step *= 0.75;
+                }
+            }
+        }
+        pi = best_pi;
+    }
+
+    double weight(int u, int v, const std::vector<double> &pi) const {
+        return cost[u][v] + pi[u] + pi[v];
+    }
+
+    double calcPiSum(const std::vector<double> &pi) const {
+        double pi_sum = 0;
+        for (int i = 0; i < N; ++i) {
+            pi_sum += pi[i];
+        }
+        return pi_sum;
+    }
+
+    double calcBound(const std::vector<double> &pi, std::vector<int> &degree,
+                     std::vector<int> &parent) const {
+        return calcOneTree(pi, degree, parent) - 2 * calcPiSum(pi);
+    }
+
+    double calcSparseBound(const std::vector<double> &pi,
+                           std::vector<int> &degree,
+                           const std::vector<std::vector<int>> &candidates)
+        const {
+        return calcSparseOneTree(pi, degree, candidates) - 2 * calcPiSum(pi);
+    }
+
+    static long long calcNorm(const std::vector<int> &degree) {
+        long long norm = 0;
+        for (int d : degree) {
+            norm += (long long)(d - 2) * (d - 2);
+        }
+        return norm;
+    }
+
+    // 各ノードの pi を加えた重みで近い candidate_size 個に、全体の最小全域木の
+    // 辺を加える。木の辺があるのでノード 0 を除いても疎なグラフは連結になる
+    std::vector<std::vector<int>>
+    buildCandidates(const std::vector<double> &pi,
+                    const std::vector<int> &parent) const {
+        std::vector<std::vector<int>> candidates(N);
+        const int k = std::min(candidate_size, N - 1);
+#pragma omp parallel for schedule(dynamic)
+        for (int u = 0; u < N; ++u) {
+            std::vector<int> others;
+            for (int v = 0; v < N; ++v) {
+                if (v != u) {
+                    others.push_back(v);
+                }
+            }
+            std::nth_element(others.begin(), others.begin() + k - 1,
+                             others.end(), [&](int x, int y) {
+                                 return weight(u, x, pi) < weight(u, y, pi);
+                             });
+            others.resize(k);
+            candidates[u] = others;
+        }
+        for (int v = 1; v < N; ++v) {
+            if (parent[v] != -1) {
+                candidates[v].push_back(parent[v]);
+            }
+        }
+        std::vector<std::vector<int>> symmetric = candidates;
+        for (int u = 0; u < N; ++u) {
+            for (int v : candidates[u]) {
+                symmetric[v].push_back(u);
+            }
+        }
+        for (std::vector<int> &neighbors : symmetric) {
+            std::sort(neighbors.begin(), neighbors.end());
+            neighbors.erase(std::unique(neighbors.begin(), neighbors.end()),
+                            neighbors.end());
+        }
+        return symmetric;
+    }
+
+    // ノード 0 を除いた最小全域木にノード 0 からの最短 2 辺を加える
+    double calcOneTree(const std::vector<double> &pi, std::vector<int> &degree,
+                       std::vector<int> &parent) const {
+        std::fill(degree.begin(), degree.end(), 0);
+        std::vector<double> key(N, DBL_MAX);
+        std::fill(parent.begin(), parent.end(), -1);
+        std::vector<bool> used(N, false);
+        used[0] = true;
+
+        double total = 0;
+        int u = 1;
+        for (int k = 1; k < N; ++k) {
+            used[u] = true;
+            if (parent[u] != -1) {
+                total += key[u];
+                ++degree[u];
+                ++degree[parent[u]];
+            }
+
+            MinKey next{DBL_MAX, -1};
+#pragma omp parallel for reduction(minKey : next)
+            for (int v = 1; v < N; ++v) {
+                if (used[v]) {
+                    continue;
+                }
+                double w = weight(u, v, pi);
+                if (w < key[v]) {
+                    key[v] = w;
+                    parent[v] = u;
+                }
+                if (key[v] < next.key) {
+                    next = {key[v], v};
+                }
+            }
+            u = next.id;
+        }
+
+        return total + addRootEdges(pi, degree, [&](auto visit) {
+                   for (int v = 1; v < N; ++v) {
+                       visit(v);
+                   }
+               });
+    }
+
+    double calcSparseOneTree(
+        const std::vector<double> &pi, std::vector<int> &degree,
+        const std::vector<std::vector<int>> &candidates) const {
+        std::fill(degree.begin(), degree.end(), 0);
+        std::vector<double> key(N, DBL_MAX);
+        std::vector<int> parent(N, -1);
+        std::vector<bool> used(N, false);
+        used[0] = true;
+        std::priority_queue<std::pair<double, int>,
+                            std::vector<std::pair<double, int>>,
+                            std::greater<std::pair<double, int>>>
+            pq;
+        key[1] = 0;
+        pq.push({0, 1});
+
+        double total = 0;
+        while (!pq.empty()) {
+            auto [k, u] = pq.top();
+            pq.pop();
+            if (used[u] || k > key[u]) {
+                continue;
+            }
+            used[u] = true;
+            if (parent[u] != -1) {
+                total += k;
+                ++degree[u];
+                ++degree[parent[u]];
+            }
+            for (int v : candidates[u]) {
+                if (used[v]) {
+                    continue;
+                }
+                double w = weight(u, v, pi);
+                if (w < key[v]) {
+                    key[v] = w;
+                    parent[v] = u;
+                    pq.push({w, v});
+                }
+            }
+        }
+
+        return total + addRootEdges(pi, degree, [&](auto visit) {
+                   for (int v : candidates[0]) {
+                       visit(v);
+                   }
+               });
+    }
+
+    // ノード 0 から forEach で列挙したノードへの辺のうち最短の 2 本を加える
+    template <class F>
+    double addRootEdges(const std::vector<double> &pi, std::vector<int> &degree,
+                        F forEach) const {
+        MinKey first{DBL_MAX, -1};
+        MinKey second{DBL_MAX, -1};
+        forEach([&](int v) {
+            double w = weight(0, v, pi);
+            if (w < first.key) {
+                second = first;
+                first = {w, v};
+            } else if (w < second.key) {
+                second = {w, v};
+            }
+        });
+        degree[0] += 2;
+        ++degree[first.id];
+        ++degree[second.id];
+        return first.key + second.key;
+    }
+};
+
+long long calcTourLength(const std::vector<std::vector<int>> &cost,
+                         const std::vector<int> &tour) {
+    long long length = 0;
+    const int N = tour.size();
+    for (int i = 0; i < N; ++i) {
+        int to = i < N - 1 ? tour[i + 1] : tour[0];
+        length += cost[tour[i]][to];
+    }
+    return length;
+}
+
+// 指定した頂点の周辺だけを 2-opt と Or-opt で改善する
+class LocalSearch {
+  public:
+    LocalSearch(const std::vector<std::vector<int>> &cost, int neighbor_size)
+        : cost(cost), N(cost.size()), neighbor_size(neighbor_size),
+          nearest(N) {}
+
+    std::vector<int> improve(std::vector<int> tour,
+                             const std::vector<int> &active, int max_moves) {
+        this->tour = tour;
+        pos.assign(N, -1);
+        updatePosition();
+
+        std::deque<int> queue;
+        std::vector<bool> queued(N, false);
+        auto push = [&](int v) {
+            if (!queued[v]) {
+                queued[v] = true;
+                queue.push_back(v);
+            }
+        };
+        for (int v : active) {
+            push(v);
+        }
+
+        int moves = 0;
+        while (!queue.empty() && moves < max_moves) {
+            int a = queue.front();
+            queue.pop_front();
+            queued[a] = false;
+
+            std::vector<int> touched;
+            if (!twoOpt(a, touched) && !orOpt(a, touched)) {
+                continue;
+            }
+            ++moves;
+            push(a);
+            for (int v : touched) {
+                push(v);
+            }
+        }
+
+        return this->tour;
+    }
+
+  private:
+    const std::vector<std::vector<int>> &cost;
+    const int N;
+    const int neighbor_size;
+    std::vector<std::vector<int>> nearest;
+    std::vector<int> tour;
+    std::vector<int> pos;
+
+    int size() const { return tour.size(); }
+
+    int succ(int v) const { return tour[(pos[v] + 1) % size()]; }
+
+    int pred(int v) const { return tour[(pos[v] + size() - 1) % size()]; }
+
+    long long distance(int u, int v) const { return cost[u][v]; }
+
+    static bool contains(const std::vector<int> &segment, int v) {
+        return std::find(segment.begin(), segment.end(), v) != segment.end();
+    }
+
+    void updatePosition() {
+        for (int i = 0; i < size(); ++i) {
+            pos[tour[i]] = i;
+        }
+    }
+
+    const std::vector<int> &getNearest(int v) {
+        if (nearest[v].empty()) {
+            std::vector<int> candidates;
+            for (int u : tour) {
+                if (u != v) {
+                    candidates.push_back(u);
+                }
+            }
+            int k = std::min<int>(neighbor_size, candidates.size());
+            std::partial_sort(candidates.begin(), candidates.begin() + k,
+                              candidates.end(), [&](int x, int y) {
+                                  return cost[v][x] != cost[v][y]
+                                             ? cost[v][x] < cost[v][y]
+                                             : x < y;
+                              });
+            candidates.resize(k);
+            nearest[v] = candidates;
+        }
+        return nearest[v];
+    }
+
+    // 位置 i から j まで (巡回) を反転する。対称なので短い側を反転してよい
+    void reverse(int i, int j) {
+        const int n = size();
+        int length = (j - i + n) % n + 1;
+        if (length * 2 > n) {
+            std::swap(i, j);
+            i = (i + 1) % n;
+            j = (j + n - 1) % n;
+            length = n - length;
+        }
+        for (int k = 0; k < length / 2; ++k) {
+            int x = (i + k) % n;
+            int y = (j - k + n) % n;
+            std::swap(tour[x], tour[y]);
+            pos[tour[x]] = x;
+            pos[tour[y]] = y;
+        }
+    }
+
+    bool twoOpt(int a, std::vector<int> &touched) {
+        if (size() < 4) {
+            return false;
+        }
+        for (int c : getNearest(a)) {
+            // a-succ(a), c-succ(c) を a-c, succ(a)-succ(c) につなぎ替える
+            int b = succ(a);
+            int d = succ(c);
+            if (c != b && d != a &&
+                distance(a, c) + distance(b, d) <
+                    distance(a, b) + distance(c, d)) {
+                reverse(pos[b], pos[c]);
+                touched = {b, c, d};
+                return true;
+            }
+            // pred(a)-a, pred(c)-c を a-c, pred(a)-pred(c) につなぎ替える
+            b = pred(a);
+            d = pred(c);
+            if (c != b && d != a &&
+                distance(a, c) + distance(b, d) <
+                    distance(b, a) + distance(d, c)) {
+                reverse(pos[c], pos[b]);
+                touched = {b, c, d};
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // a から始まる長さ 1〜3 の区間を別の辺の間に移す
+    bool orOpt(int a, std::vector<int> &touched) {
+        for (int length = 1; length <= 3 && length + 2 < size(); ++length) {
+            std::vector<int> segment{a};
+            while ((int)segment.size() < length) {
+                segment.push_back(succ(segment.back()));
+            }
+            int first = segment.front();
+            int last = segment.back();
+            int p = pred(first);
+            int n = succ(last);
+            long long removed =
+                distance(p, first) + distance(last, n) - distance(p, n);
+
+            for (int target : getNearest(a)) {
+                if (contains(segment, target)) {
+                    continue;
+                }
+                for (int side = 0; side < 2; ++side) {
+                    int x = side == 0 ? target : pred(target);
+                    int y = side == 0 ? succ(target) : target;
+                    if (contains(segment, x) || contains(segment, y)) {
+                        continue;
+                    }
+                    long long forward =
+                        distance(x, first) + distance(last, y);
+                    long long backward =
+                        distance(x, last) + distance(first, y);
+                    long long added =
+                        std::min(forward, backward) - distance(x, y);
+                    if (added >= removed) {
+                        continue;
+                    }
+
+                    std::vector<int> next;
+                    for (int v = n; v != first; v = succ(v)) {
+                        next.push_back(v);
+                        if (v == x) {
+                            if (forward <= backward) {
+                                next.insert(next.end(), segment.begin(),
+                                            segment.end());
+                            } else {
+                                next.insert(next.end(), segment.rbegin(),
+                                            segment.rend());
+                            }
+                        }
+                    }
+                    tour = next;
+                    updatePosition();
+                    touched = {p, n, x, y, first, last};
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
 class JoinRepository {
   public:
     explicit JoinRepository(const std::vector<Join> &joins) {
@@ -258,6 +1742,7 @@ class LineRepository {
 
 std::vector<Station> readStations(std::string file_path) {
     std::vector<Station> stations;
+    StringArena &arena = getStationArena();
     std::ifstream fs(file_path);
     if (fs.fail()) {
         std::cerr << "Failed to open file." << std::endl;
@@ -277,7 +1762,7 @@ std::vector<Station> readStations(std::string file_path) {
         int group_code = stoi(sep);
 
         getline(ss, sep, ',');
-        std::string name = sep;
+        std::string_view name = arena.intern(sep);
 
         // station_name_k
         getline(ss, sep, ',');
@@ -292,10 +1777,10 @@ std::vector<Station> readStations(std::string file_path) {
         int prefecture_code = stoi(sep);
 
         getline(ss, sep, ',');
-        std::string post = sep;
+        std::string_view post = arena.intern(sep);
 
         getline(ss, sep, ',');
-        std::string address = sep;
+        std::string_view address = arena.intern(sep);
 
         getline(ss, sep, ',');
         double lon = stod(sep);
@@ -303,20 +1788,20 @@ std::vector<Station> readStations(std::string file_path) {
         getline(ss, sep, ',');
         double lat = stod(sep);
 
-        Station station{code, group_code, name, line_code, prefecture_code,
-                        post, address,    lon,  lat};
+        Station station{code, group_code, line_code, prefecture_code, lon,
+                        lat,  name,       post,      address};
         stations.push_back(station);
     }
 
     return stations;
 }
 
-std::vector<Join> readJoins(std::string file_path) {
-    std::vector<Join> joins;
+// 全体を読み込まずに 1 行ずつ処理する
+template <class F> void forEachJoin(std::string file_path, F f) {
     std::ifstream fs(file_path);
     if (fs.fail()) {
         std::cerr << "Failed to open file." << std::endl;
-        return joins;
+        return;
     }
 
     std::string line;
@@ -335,9 +1820,13 @@ std::vector<Join> readJoins(std::string file_path) {
         int station_code2 = stoi(sep);
 
         Join join{code, station_code1, station_code2};
-        joins.push_back(join);
+        f(join);
     }
+}
 
+std::vector<Join> readJoins(std::string file_path) {
+    std::vector<Join> joins;
+    forEachJoin(file_path, [&](const Join &join) { joins.push_back(join); });
     return joins;
 }
 
@@ -369,6 +1858,33 @@ std::vector<Line> readLines(std::string file_path) {
     return lines;
 }
 
+std::vector<Coordinate> readCoordinates(std::string file_path) {
+    std::vector<Coordinate> coordinates;
+    std::ifstream fs(file_path);
+    if (fs.fail()) {
+        std::cerr << "Failed to open file." << std::endl;
+        return coordinates;
+    }
+
+    std::string line;
+    getline(fs, line);
+    while (getline(fs, line)) {
+        std::stringstream ss{line};
+        std::string sep;
+
+        getline(ss, sep, ',');
+        double lat = stod(sep);
+
+        getline(ss, sep, ',');
+        double lon = stod(sep);
+
+        Coordinate coordinate{lat, lon};
+        coordinates.push_back(coordinate);
+    }
+
+    return coordinates;
+}
+
 std::vector<Group> readGroup(std::string file_path) {
     std::vector<Group> groups;
     std::ifstream fs(file_path);
@@ -423,6 +1939,292 @@ std::vector<int> readTour(std::string file_path) {
     return tour;
 }
 
+std::vector<std::vector<int>> readProblem(std::string file_path) {
+    std::ifstream fs(file_path);
+    if (fs.fail()) {
+        std::cerr << "Failed to open file." << std::endl;
+        return {};
+    }
+
+    int N = 0;
+    std::string line;
+    while (getline(fs, line)) {
+        if (line.rfind("DIMENSION", 0) == 0) {
+            N = stoi(line.substr(line.find(':') + 1));
+        }
+        if (line.rfind("EDGE_WEIGHT_SECTION", 0) == 0) {
+            break;
+        }
+    }
+
+    std::vector<std::vector<int>> cost(N, std::vector<int>(N));
+    for (int i = 0; i < N; ++i) {
+        for (int j = 0; j < N; ++j) {
+            fs >> cost[i][j];
+        }
+    }
+
+    return cost;
+}
+
+// 書き込まれた内容を BLOCK_SIZE 以上のブロックにまとめ、バックグラウンドの
+// スレッドが pwrite する。std::ostream に渡して使い、flush しても待たない。
+// close するまで書き終わりは保証しない。
+class AsyncWriter : public std::streambuf {
+  public:
+    explicit AsyncWriter(const std::string &file_path) {
+        fd = open(file_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "Failed to open file." << std::endl;
+            failed = true;
+        }
+        worker = std::thread([this] { run(); });
+    }
+
+    AsyncWriter(const AsyncWriter &) = delete;
+    AsyncWriter &operator=(const AsyncWriter &) = delete;
+
+    ~AsyncWriter() { close(); }
+
+    // 残りを書き出してスレッドを止める。書き込みに失敗していれば false
+    bool close() {
+        if (worker.joinable()) {
+            submit(std::move(buffer));
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                closed = true;
+            }
+            cv.notify_all();
+            worker.join();
+            if (fd >= 0 && ::close(fd) != 0) {
+                failed = true;
+            }
+        }
+        return !failed;
+    }
+
+  protected:
+    std::streamsize xsputn(const char *s, std::streamsize n) override {
+        buffer.append(s, n);
+        if (buffer.size() >= BLOCK_SIZE) {
+            flushBlocks();
+        }
+        return n;
+    }
+
+    int overflow(int c) override {
+        if (c != traits_type::eof()) {
+            buffer.push_back(c);
+            if (buffer.size() >= BLOCK_SIZE) {
+                flushBlocks();
+            }
+        }
+        return c;
+    }
+
+    int sync() override { return 0; }
+
+  private:
+    static constexpr size_t BLOCK_SIZE = 1 << 22;
+    static constexpr size_t MAX_PENDING = 8;
+
+    int fd = -1;
+    off_t offset = 0;
+    std::string buffer;
+    std::deque<std::string> blocks;
+    std::vector<std::string> spare;
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool closed = false;
+    bool failed = false;
+    std::thread worker;
+
+    // ブロックはコピーせずにスレッドへ渡し、書き終えたバッファを使い回す
+    void flushBlocks() {
+        submit(std::move(buffer));
+        std::lock_guard<std::mutex> lock(mtx);
+        if (spare.empty()) {
+            buffer = std::string();
+        } else {
+            buffer = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+
+    void submit(std::string block) {
+        if (block.empty()) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return blocks.size() < MAX_PENDING; });
+        blocks.push_back(std::move(block));
+        cv.notify_all();
+    }
+
+    void run() {
+        while (true) {
+            std::string block;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [&] { return closed || !blocks.empty(); });
+                if (blocks.empty()) {
+                    return;
+                }
+                block = std::move(blocks.front());
+                blocks.pop_front();
+            }
+            cv.notify_all();
+
+            size_t written = 0;
+            while (fd >= 0 && written < block.size()) {
+                ssize_t n = pwrite(fd, block.data() + written,
+                                   block.size() - written, offset + written);
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    failed = true;
+                    break;
+                }
+                written += n;
+            }
+            offset += block.size();
+
+            block.clear();
+            std::lock_guard<std::mutex> lock(mtx);
+            spare.push_back(std::move(block));
+        }
+    }
+};
+
+// 行ごとに並列に求めた結果を、求まった順に関係なく行番号順に待つ
+class RowQueue {
+  public:
+    explicit RowQueue(int N) : done(N, false) {}
+
+    void push(int i) {
+        std::lock_guard<std::mutex> lock(mtx);
+        done[i] = true;
+        cv.notify_all();
+    }
+
+    void wait(int i) {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [&] { return done[i]; });
+    }
+
+  private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<bool> done;
+};
+
+void writeProblemHeader(std::ostream &os, int N) {
+    os << "NAME : railway" << std::endl;
+    os << "COMMENT : Japanese railway problem" << std::endl;
+    os << "TYPE : tsp" << std::endl;
+    os << "DIMENSION : " << N << std::endl;
+    os << "EDGE_WEIGHT_TYPE : EXPLICIT" << std::endl;
+    os << "EDGE_WEIGHT_FORMAT : FULL_MATRIX" << std::endl;
+    os << "EDGE_WEIGHT_SECTION" << std::endl;
+}
+
+// 行は区切らずに続けて書き、最後の行のあとに writeProblemFooter を書く
+std::string formatProblemRow(const std::vector<double> &row, int N) {
+    std::string s = "";
+    for (int j = 0; j < N; ++j) {
+        if (row[j] == DBL_MAX) {
+            s += "-1 ";
+        } else {
+            s += std::to_string(lround(row[j])) + " ";
+        }
+    }
+    return s;
+}
+
+void writeProblemFooter(std::ostream &os) {
+    os << std::endl << "EOF" << std::endl;
+}
+
+void writeProblem(std::ostream &os,
+                  const std::vector<std::vector<double>> &distance) {
+    const int N = distance.size();
+    writeProblemHeader(os, N);
+
+    // 高速化のため複数行まとめて整形し、書き出しと重ねる
+    for (int begin = 0; begin < N; begin += WRITE_CHUNK_SIZE) {
+        const int end = std::min(begin + WRITE_CHUNK_SIZE, N);
+        std::vector<std::string> lines(end - begin);
+#pragma omp parallel for
+        for (int i = begin; i < end; ++i) {
+            lines[i - begin] = formatProblemRow(distance[i], N);
+        }
+        for (const std::string &line : lines) {
+            os << line;
+        }
+    }
+    writeProblemFooter(os);
+}
+
+// 行 i は rowQueue に push されてから書く。最短路の計算と並行して呼ぶ
+void writeProblem(std::ostream &os,
+                  const std::vector<std::vector<double>> &distance,
+                  RowQueue &rowQueue) {
+    const int N = distance.size();
+    writeProblemHeader(os, N);
+    for (int i = 0; i < N; ++i) {
+        rowQueue.wait(i);
+        os << formatProblemRow(distance[i], N);
+    }
+    writeProblemFooter(os);
+}
+
+void writeTour(std::ostream &os, const std::vector<int> &tour,
+               long long length, const std::string &solver = "reopt") {
+    os << "NAME : railway." << length << ".tour" << std::endl;
+    os << "COMMENT : Length = " << length << std::endl;
+    os << "COMMENT : Found by " << solver << std::endl;
+    os << "TYPE : TOUR" << std::endl;
+    os << "DIMENSION : " << tour.size() << std::endl;
+    os << "TOUR_SECTION" << std::endl;
+    for (int node_id : tour) {
+        os << node_id + 1 << std::endl;
+    }
+    os << "-1" << std::endl;
+    os << "EOF" << std::endl;
+}
+
+void writeShortestPath(std::ostream &os,
+                       const std::vector<std::vector<int>> &next) {
+    const int N = next.size();
+    // 高速化のため複数行まとめて整形し、書き出しと重ねる
+    for (int begin = 0; begin < N; begin += WRITE_CHUNK_SIZE) {
+        const int end = std::min(begin + WRITE_CHUNK_SIZE, N);
+        std::vector<std::string> lines(end - begin);
+#pragma omp parallel for
+        for (int i = begin; i < end; ++i) {
+            std::string s = "";
+            for (int j = 0; j < (int)next[i].size(); ++j) {
+                s += std::to_string(next[i][j]) + ",";
+            }
+            s += "\n";
+            lines[i - begin] = std::move(s);
+        }
+        for (const std::string &line : lines) {
+            os << line;
+        }
+    }
+}
+
+void writeNode(std::ostream &os, const NodeRepository &nodeRepository) {
+    os << "node_id,station_cd" << std::endl;
+    for (int i = 0; i < nodeRepository.size(); ++i) {
+        Node node = nodeRepository.getNodeById(i).value();
+        os << std::to_string(node.node_id) << ","
+           << std::to_string(node.station_code) << std::endl;
+    }
+}
+
 std::vector<Node> readNode(std::string file_path) {
     std::vector<Node> nodes;
     std::ifstream fs(file_path);
@@ -450,6 +2252,21 @@ std::vector<Node> readNode(std::string file_path) {
     return nodes;
 }
 
+std::optional<CompressedPathRepository>
+readCompressedShortestPath(std::string file_path) {
+    std::ifstream fs(file_path, std::ios::binary);
+    if (fs.fail()) {
+        std::cerr << "Failed to open file." << std::endl;
+        return std::nullopt;
+    }
+    try {
+        return CompressedPathRepository(fs);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
 std::vector<Path> readShortestPath(std::string file_path) {
     std::ifstream fs(file_path);
     if (fs.fail()) {
@@ -465,13 +2282,12 @@ std::vector<Path> readShortestPath(std::string file_path) {
         lines.push_back(line);
     }
 
+    // 路線ごとの状態を含むときは列 (駅) より行が多い
     int N = lines.size() - 1;
     for (int i = 0; i < N; ++i) {
         std::stringstream ss{lines[i]};
-        for (int j = 0; j < N; ++j) {
-            std::string field;
-
-            getline(ss, field, ',');
+        std::string field;
+        for (int j = 0; getline(ss, field, ','); ++j) {
             int next = stoi(field);
 
             paths.push_back({i, j, next});
@@ -0,0 +1,564 @@
+#include "railway.h"
+#include <bits/stdc++.h>
+#include <csignal>
+#include <nlohmann/json.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace railway;
+using namespace std;
+using json = nlohmann::json;
+
+struct Config {
+    string station_file;
+    string join_file;
+    string group_file;
+    string node_file;
+    string path_file;
+};
+
+// 一度読み込んだら変更しない。再読み込み時は丸ごと差し替える
+class Snapshot {
+  public:
+    explicit Snapshot(const Config &config)
+        : stations(readStations(config.station_file)),
+          stationRepository(stations), stationIndex(stations),
+          groupRepository(readGroup(config.group_file)),
+          graph(&nodeRepository) {
+        buildGraph(
+            stations, stationRepository, readJoins(config.join_file),
+            [](int) { return true; }, nodeRepository, graph);
+
+        const int N = graph.getNodeSize();
+        adjacency.resize(N);
+        for (int i = 0; i < N; ++i) {
+            Station station1 = getStationByNodeId(i);
+            for (int j : graph.getNeighbors(i)) {
+                Station station2 = getStationByNodeId(j);
+                double distance = calcDistance({station1.lat, station1.lon},
+                                               {station2.lat, station2.lon});
+                adjacency[i].push_back({j, distance});
+            }
+        }
+
+        if (!config.node_file.empty()) {
+            for (const Node &node : readNode(config.node_file)) {
+                pathNodeRepository.addNode(node);
+            }
+            pathRepository = readCompressedShortestPath(config.path_file);
+            if (!pathRepository) {
+                throw runtime_error("Failed to read shortest path.");
+            }
+        }
+    }
+
+    string handle(const string &request) const {
+        vector<string> args;
+        string command = parseRequest(request, args);
+
+        json response;
+        try {
+            response = dispatch(command, args);
+        } catch (const exception &e) {
+            response = {{"error", e.what()}};
+        }
+        return response.dump();
+    }
+
+    // tsp は応答が大きく時間もかかるので、プールに渡さずに接続のスレッドで
+    // 求めた行から書き出す
+    static bool isStreamed(const string &request) {
+        vector<string> args;
+        return parseRequest(request, args) == "tsp" && args.size() == 1;
+    }
+
+    // 改行までの 1 行を send で少しずつ返す。send が false を返せば打ち切る
+    bool stream(const string &request,
+                const function<bool(const string &)> &send) const {
+        vector<string> args;
+        parseRequest(request, args);
+        int code;
+        try {
+            code = stoi(args[0]);
+        } catch (const exception &e) {
+            return send(json{{"error", e.what()}}.dump() + "\n");
+        }
+        return exportProblem(code, send);
+    }
+
+  private:
+    vector<Station> stations;
+    StationRepository stationRepository;
+    StationIndex stationIndex;
+    GroupRepository groupRepository;
+    NodeRepository nodeRepository;
+    Graph graph;
+    vector<vector<pair<int, double>>> adjacency;
+    NodeRepository pathNodeRepository;
+    optional<CompressedPathRepository> pathRepository;
+
+    static string parseRequest(const string &request, vector<string> &args) {
+        stringstream ss{request};
+        string command;
+        ss >> command;
+        string arg;
+        while (ss >> arg) {
+            args.push_back(arg);
+        }
+        return command;
+    }
+
+    json dispatch(const string &command, const vector<string> &args) const {
+        if (command == "station" && args.size() == 1) {
+            return {{"station", toJson(getStation(stoi(args[0])))}};
+        }
+        if (command == "nearest" && args.size() == 3) {
+            json stations = json::array();
+            for (const NearStation &near : stationIndex.getNearestStations(
+                     {stod(args[0]), stod(args[1])}, stoi(args[2]))) {
+                stations.push_back(
+                    {{"station_code", near.station.station_code},
+                     {"distance", near.distance}});
+            }
+            return {{"stations", stations}};
+        }
+        if (command == "distance" && args.size() == 2) {
+            vector<int> path = findPath(stoi(args[0]), stoi(args[1]));
+            return {{"distance", calcPathDistance(path)}};
+        }
+        if (command == "path" && args.size() == 2) {
+            return {{"path", findPath(stoi(args[0]), stoi(args[1]))}};
+        }
+        if (command == "tour" && !args.empty()) {
+            vector<int> codes;
+            for (const string &arg : args) {
+                codes.push_back(stoi(arg));
+            }
+            return {{"tour", expandTour(codes)}};
+        }
+        throw invalid_argument("Unknown request.");
+    }
+
+    Station getStation(int code) const {
+        optional<Station> station = stationRepository.getStationByCode(code);
+        if (!station) {
+            throw invalid_argument("Unknown station.");
+        }
+        return station.value();
+    }
+
+    Station getStationByNodeId(int id) const {
+        return getStation(graph.getNodeById(id).value().station_code);
+    }
+
+    int getNodeId(int code) const {
+        optional<Node> node = nodeRepository.getNodeByStationCode(code);
+        if (!node) {
+            throw invalid_argument("Station is not on the network.");
+        }
+        return node->node_id;
+    }
+
+    static json toJson(const Station &station) {
+        Prefectures prefecture;
+        return {{"station_code", station.station_code},
+                {"station_group_code", station.station_group_code},
+                {"station_name", station.station_name},
+                {"line_code", station.line_code},
+                {"prefecture",
+                 prefecture.getPrefectureNameById(station.prefecture_code)},
+                {"post", station.post},
+                {"address", station.address},
+                {"lon", station.lon},
+                {"lat", station.lat}};
+    }
+
+    double calcPathDistance(const vector<int> &path) const {
+        double distance = 0;
+        for (int i = 0; i + 1 < (int)path.size(); ++i) {
+            Station station1 = getStation(path[i]);
+            Station station2 = getStation(path[i + 1]);
+            distance += calcDistance({station1.lat, station1.lon},
+                                     {station2.lat, station2.lon});
+        }
+        return distance;
+    }
+
+    // 読み込み済みの経路があればそれを辿り、なければ Dijkstra で探す
+    vector<int> findPath(int from, int to) const {
+        if (pathRepository) {
+            optional<Node> node1 =
+                pathNodeRepository.getNodeByStationCode(from);
+            optional<Node> node2 =
+                pathNodeRepository.getNodeByStationCode(to);
+            if (node1 && node2) {
+                vector<int> path{from};
+                int current = node1->node_id;
+                while (current != node2->node_id) {
+                    current = pathRepository->getNext(current, node2->node_id);
+                    if (current == -1) {
+                        throw invalid_argument("Station is unreachable.");
+                    }
+                    // 路線ごとの状態を辿るときは同じ駅が続く
+                    int code =
+                        pathNodeRepository.getNodeById(current)->station_code;
+                    if (path.back() != code) {
+                        path.push_back(code);
+                    }
+                }
+                return path;
+            }
+        }
+
+        int source = getNodeId(from);
+        int target = getNodeId(to);
+        const int N = graph.getNodeSize();
+        vector<double> distance(N, DBL_MAX);
+        vector<int> prev(N, -1);
+        distance[source] = 0;
+        priority_queue<pair<double, int>, vector<pair<double, int>>,
+                       greater<pair<double, int>>>
+            pq;
+        pq.push({0, source});
+        while (!pq.empty()) {
+            auto [d, current] = pq.top();
+            pq.pop();
+            if (current == target) {
+                break;
+            }
+            if (d > distance[current]) {
+                continue;
+            }
+            for (auto [neighbor, cost] : adjacency[current]) {
+                if (d + cost < distance[neighbor]) {
+                    distance[neighbor] = d + cost;
+                    pq.push({distance[neighbor], neighbor});
+                    prev[neighbor] = current;
+                }
+            }
+        }
+        if (distance[target] == DBL_MAX) {
+            throw invalid_argument("Station is unreachable.");
+        }
+
+        vector<int> path;
+        for (int v = target; v != -1; v = prev[v]) {
+            path.push_back(graph.getNodeById(v)->station_code);
+        }
+        reverse(path.begin(), path.end());
+        return path;
+    }
+
+    // tour と同じく、各区間の終点は次の区間の始点として出力する
+    vector<int> expandTour(const vector<int> &codes) const {
+        vector<int> tour;
+        const int N = codes.size();
+        for (int i = 0; i < N; ++i) {
+            int to = i < N - 1 ? codes[i + 1] : codes[0];
+            vector<int> path = findPath(codes[i], to);
+            tour.insert(tour.end(), path.begin(), path.end() - 1);
+        }
+        return tour;
+    }
+
+    vector<double> calcDistances(int source) const {
+        vector<double> distance(graph.getNodeSize(), DBL_MAX);
+        distance[source] = 0;
+        priority_queue<pair<double, int>, vector<pair<double, int>>,
+                       greater<pair<double, int>>>
+            pq;
+        pq.push({0, source});
+        while (!pq.empty()) {
+            auto [d, current] = pq.top();
+            pq.pop();
+            if (d > distance[current]) {
+                continue;
+            }
+            for (auto [neighbor, cost] : adjacency[current]) {
+                if (d + cost < distance[neighbor]) {
+                    distance[neighbor] = d + cost;
+                    pq.push({distance[neighbor], neighbor});
+                }
+            }
+        }
+        return distance;
+    }
+
+    // 指定した駅と同じグループの駅からなる TSP を tsp と同じ形式で返す。
+    // 行列は持たず、WRITE_CHUNK_SIZE 行ずつ並列に求めて JSON の文字列の
+    // 続きとして書き出す。行は数字と空白だけなのでエスケープはいらない
+    bool exportProblem(int code,
+                       const function<bool(const string &)> &send) const {
+        vector<int> region;
+        for (int i = 0; i < graph.getNodeSize(); ++i) {
+            if (groupRepository.isSame(graph.getNodeById(i)->station_code,
+                                       code)) {
+                region.push_back(i);
+            }
+        }
+        const int N = region.size();
+
+        json nodes = json::array();
+        for (int id : region) {
+            nodes.push_back(graph.getNodeById(id)->station_code);
+        }
+        stringstream header;
+        writeProblemHeader(header, N);
+        string tsp_header = json(header.str()).dump();
+        tsp_header.pop_back();
+        stringstream footer;
+        writeProblemFooter(footer);
+        string tsp_footer = json(footer.str()).dump();
+        tsp_footer.erase(0, 1);
+
+        if (!send("{\"nodes\":" + nodes.dump() + ",\"tsp\":" + tsp_header)) {
+            return false;
+        }
+        for (int begin = 0; begin < N; begin += WRITE_CHUNK_SIZE) {
+            const int end = min(begin + WRITE_CHUNK_SIZE, N);
+            vector<string> lines(end - begin);
+#pragma omp parallel for schedule(dynamic)
+            for (int i = begin; i < end; ++i) {
+                vector<double> distance = calcDistances(region[i]);
+                vector<double> row(N);
+                for (int j = 0; j < N; ++j) {
+                    row[j] = distance[region[j]];
+                }
+                lines[i - begin] = formatProblemRow(row, N);
+            }
+            for (const string &line : lines) {
+                if (!send(line)) {
+                    return false;
+                }
+            }
+        }
+        return send(tsp_footer + "}\n");
+    }
+};
+
+class Server {
+  public:
+    explicit Server(const Config &config)
+        : config(config), snapshot(make_shared<const Snapshot>(config)) {}
+
+    shared_ptr<const Snapshot> getSnapshot() {
+        lock_guard<mutex> lock(mtx);
+        return snapshot;
+    }
+
+    // 処理中のリクエストは古いスナップショットを持ち続けるので中断されない。
+    // 駅の文字列を共有のアリーナに登録するので、読み込みは 1 つずつ行う
+    void reload() {
+        lock_guard<mutex> reload_lock(reload_mtx);
+        auto next = make_shared<const Snapshot>(config);
+        lock_guard<mutex> lock(mtx);
+        snapshot = next;
+    }
+
+    string handle(const string &request) {
+        if (request == "reload") {
+            try {
+                reload();
+            } catch (const exception &e) {
+                return json{{"error", e.what()}}.dump();
+            }
+            return json{{"reloaded", true}}.dump();
+        }
+        return getSnapshot()->handle(request);
+    }
+
+    static bool isStreamed(const string &request) {
+        return Snapshot::isStreamed(request);
+    }
+
+    bool stream(const string &request,
+                const function<bool(const string &)> &send) {
+        return getSnapshot()->stream(request, send);
+    }
+
+  private:
+    const Config config;
+    mutex mtx;
+    mutex reload_mtx;
+    shared_ptr<const Snapshot> snapshot;
+};
+
+class ThreadPool {
+  public:
+    explicit ThreadPool(int size) {
+        for (int i = 0; i < size; ++i) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(mtx);
+            stopped = true;
+        }
+        cv.notify_all();
+        for (thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void submit(function<void()> task) {
+        {
+            lock_guard<mutex> lock(mtx);
+            tasks.push(move(task));
+        }
+        cv.notify_one();
+    }
+
+  private:
+    vector<thread> workers;
+    queue<function<void()>> tasks;
+    mutex mtx;
+    condition_variable cv;
+    bool stopped = false;
+
+    void run() {
+        while (true) {
+            function<void()> task;
+            {
+                unique_lock<mutex> lock(mtx);
+                cv.wait(lock, [this] { return stopped || !tasks.empty(); });
+                if (stopped && tasks.empty()) {
+                    return;
+                }
+                task = move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+};
+
+bool writeAll(int fd, const string &s) {
+    size_t written = 0;
+    while (written < s.size()) {
+        ssize_t n = write(fd, s.data() + written, s.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+// 1 行 1 リクエストで受け取り、同じ順に 1 行ずつ JSON で返す。
+// 読み書きは接続ごとのスレッドで行い、リクエストの処理だけをプールに渡すので、
+// 待っているだけの接続がワーカーを占有しない。tsp だけは接続のスレッドで
+// 書き出しながら求めるので、大きな問題を返している間もワーカーは空いている
+void serve(Server &server, ThreadPool &pool, int fd) {
+    auto send = [fd](const string &s) { return writeAll(fd, s); };
+    string buffer;
+    char chunk[1 << 16];
+    while (true) {
+        ssize_t size = read(fd, chunk, sizeof(chunk));
+        if (size <= 0) {
+            break;
+        }
+        buffer.append(chunk, size);
+
+        vector<string> requests;
+        size_t begin = 0;
+        size_t end;
+        while ((end = buffer.find('\n', begin)) != string::npos) {
+            requests.push_back(buffer.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        buffer.erase(0, begin);
+
+        vector<future<string>> results(requests.size());
+        for (size_t i = 0; i < requests.size(); ++i) {
+            if (Server::isStreamed(requests[i])) {
+                continue;
+            }
+            auto task = make_shared<packaged_task<string()>>(
+                [&server, request = requests[i]] {
+                    return server.handle(request);
+                });
+            results[i] = task->get_future();
+            pool.submit([task] { (*task)(); });
+        }
+
+        for (size_t i = 0; i < requests.size(); ++i) {
+            bool ok = results[i].valid()
+                          ? send(results[i].get() + "\n")
+                          : server.stream(requests[i], send);
+            if (!ok) {
+                close(fd);
+                return;
+            }
+        }
+    }
+    close(fd);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 5 && argc != 7) {
+        cerr << "Usage: ./railwayd <socket_path> <station_file> <join_file> "
+                "<group_file> [<node_file> <path_file>]"
+             << endl;
+        return -1;
+    }
+
+    string socket_path{argv[1]};
+    Config config{argv[2], argv[3], argv[4], argc == 7 ? argv[5] : "",
+                  argc == 7 ? argv[6] : ""};
+    unique_ptr<Server> server;
+    try {
+        server = make_unique<Server>(config);
+    } catch (const exception &e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    // ソケットの代わりに標準入出力で 1 バッチだけ処理する
+    if (socket_path == "-") {
+        string request;
+        while (getline(cin, request)) {
+            if (Server::isStreamed(request)) {
+                server->stream(request, [](const string &s) {
+                    cout << s;
+                    return bool(cout);
+                });
+            } else {
+                cout << server->handle(request) << endl;
+            }
+        }
+        return 0;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "Socket path is too long." << endl;
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path.c_str());
+    unlink(socket_path.c_str());
+    if (bind(listener, (sockaddr *)&address, sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        cerr << "Failed to listen on socket." << endl;
+        return -1;
+    }
+
+    ThreadPool pool(max(1u, thread::hardware_concurrency()));
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        thread([&server, &pool, fd] { serve(*server, pool, fd); }).detach();
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include "railway.h"
+#include <bits/stdc++.h>
+
+using namespace railway;
+using namespace std;
+
+const int NEIGHBOR_SIZE = 10;
+const int MAX_MOVES = 100000;
+
+int main(int argc, char *argv[]) {
+    if (argc != 6) {
+        cerr << "Usage: ./reopt <tsp_file> <node_file> <prev_tsp_file> "
+                "<prev_node_file> <prev_tour_file>"
+             << endl;
+        return -1;
+    }
+
+    string tsp_file{argv[1]};
+    string node_file{argv[2]};
+    string prev_tsp_file{argv[3]};
+    string prev_node_file{argv[4]};
+    string prev_tour_file{argv[5]};
+
+    vector<vector<int>> cost = readProblem(tsp_file);
+    const int N = cost.size();
+
+    // --transfer の node.csv は路線ごとの状態も含むので、TSP のノードである
+    // 先頭の DIMENSION 行だけを使う
+    vector<Node> nodes = readNode(node_file);
+    NodeRepository nodeRepository;
+    for (const Node &node : nodes) {
+        if (node.node_id >= 0 && node.node_id < N) {
+            nodeRepository.addNode(node);
+        }
+    }
+    if (N == 0 || nodeRepository.size() != N) {
+        cerr << "Problem does not match its node.csv." << endl;
+        return 1;
+    }
+
+    vector<vector<int>> prev_cost = readProblem(prev_tsp_file);
+    const int M = prev_cost.size();
+
+    vector<Node> prev_nodes = readNode(prev_node_file);
+    NodeRepository prevNodeRepository;
+    for (const Node &node : prev_nodes) {
+        if (node.node_id >= 0 && node.node_id < M) {
+            prevNodeRepository.addNode(node);
+        }
+    }
+    if (M == 0 || prevNodeRepository.size() != M) {
+        cerr << "Previous problem does not match its node.csv." << endl;
+        return 1;
+    }
+
+    // 前回のツアーは前回のノードをちょうど 1 回ずつ通らなければならない
+    vector<int> prev_tour = readTour(prev_tour_file);
+    vector<bool> prev_visited(M, false);
+    bool valid = (int)prev_tour.size() == M;
+    for (int prev_node_id : prev_tour) {
+        valid = valid && prev_node_id >= 0 && prev_node_id < M &&
+                !prev_visited[prev_node_id];
+        if (valid) {
+            prev_visited[prev_node_id] = true;
+        }
+    }
+    if (!valid) {
+        cerr << "Previous tour does not match its node.csv." << endl;
+        return 1;
+    }
+
+    // 前回のノード ID を駅コードで新しいノード ID に写す。削除された駅は -1
+    vector<int> prev_to_new(M, -1);
+    vector<int> new_to_prev(N, -1);
+    for (int prev_node_id = 0; prev_node_id < M; ++prev_node_id) {
+        Node prev_node = prevNodeRepository.getNodeById(prev_node_id).value();
+        optional<Node> node =
+            nodeRepository.getNodeByStationCode(prev_node.station_code);
+        if (node) {
+            prev_to_new[prev_node_id] = node->node_id;
+            new_to_prev[node->node_id] = prev_node_id;
+        }
+    }
+
+    // 前回のツアーを新しいノード ID に写し、削除された駅を飛ばす
+    vector<int> tour;
+    vector<int> active;
+    vector<bool> visited(N, false);
+    bool skipped = false;
+    for (int prev_node_id : prev_tour) {
+        int node_id = prev_to_new[prev_node_id];
+        if (node_id == -1) {
+            skipped = true;
+            continue;
+        }
+        if (skipped && !tour.empty()) {
+            active.push_back(tour.back());
+            active.push_back(node_id);
+        }
+        skipped = false;
+        tour.push_back(node_id);
+        visited[node_id] = true;
+    }
+    if (skipped && !tour.empty()) {
+        active.push_back(tour.back());
+        active.push_back(tour.front());
+    }
+
+    // 駅の移動や接続の追加・削除で、近くのノードかツアーで隣り合うノードとの
+    // 距離が変わったノードからも局所探索を始める
+    auto isChanged = [&](int u, int v) {
+        return new_to_prev[u] != -1 && new_to_prev[v] != -1 &&
+               cost[u][v] != prev_cost[new_to_prev[u]][new_to_prev[v]];
+    };
+    vector<char> changed(N, false);
+#pragma omp parallel for schedule(dynamic)
+    for (int z = 0; z < N; ++z) {
+        vector<int> candidates;
+        for (int y = 0; y < N; ++y) {
+            if (y != z) {
+                candidates.push_back(y);
+            }
+        }
+        int k = min<int>(NEIGHBOR_SIZE, candidates.size());
+        partial_sort(candidates.begin(), candidates.begin() + k,
+                     candidates.end(),
+                     [&](int x, int y) {
+                         return cost[z][x] != cost[z][y]
+                                    ? cost[z][x] < cost[z][y]
+                                    : x < y;
+                     });
+        for (int i = 0; i < k; ++i) {
+            changed[z] = changed[z] || isChanged(z, candidates[i]);
+        }
+    }
+    for (int i = 0; i < (int)tour.size(); ++i) {
+        int a = tour[i];
+        int b = tour[(i + 1) % tour.size()];
+        if (isChanged(a, b)) {
+            changed[a] = changed[b] = true;
+        }
+    }
+    for (int z = 0; z < N; ++z) {
+        if (changed[z]) {
+            active.push_back(z);
+        }
+    }
+
+    // 追加された駅は最安挿入する
+    for (int z = 0; z < N; ++z) {
+        if (visited[z]) {
+            continue;
+        }
+        active.push_back(z);
+        if (tour.size() < 2) {
+            tour.push_back(z);
+            continue;
+        }
+        int best = 0;
+        long long best_delta = LLONG_MAX;
+        for (int i = 0; i < (int)tour.size(); ++i) {
+            int a = tour[i];
+            int b = tour[(i + 1) % tour.size()];
+            long long delta = (long long)cost[a][z] + cost[z][b] - cost[a][b];
+            if (delta < best_delta) {
+                best_delta = delta;
+                best = i;
+            }
+        }
+        tour.insert(tour.begin() + best + 1, z);
+    }
+
+    LocalSearch localSearch(cost, NEIGHBOR_SIZE);
+    tour = localSearch.improve(tour, active, MAX_MOVES);
+
+    writeTour(cout, tour, calcTourLength(cost, tour));
+
+    return 0;
+}
@@ -30,27 +30,32 @@ int main(int argc, char *argv[]) {
 
     vector<int> tour = readTour(tour_file);
 
-    vector<Path> paths = readShortestPath(path_file);
-    PathRepository pathRepository(paths);
+    // tsp が書く shortest_path.bin も shortest_path.csv の代わりに使える
+    vector<int> station_codes;
+    if (path_file.ends_with(".bin")) {
+        optional<CompressedPathRepository> pathRepository =
+            readCompressedShortestPath(path_file);
+        if (!pathRepository) {
+            return 1;
+        }
+        station_codes = expandTour(tour, nodeRepository, [&](int from, int to) {
+            return pathRepository->getNext(from, to);
+        });
+    } else {
+        vector<Path> paths = readShortestPath(path_file);
+        PathRepository pathRepository(paths);
+        station_codes = expandTour(tour, nodeRepository, [&](int from, int to) {
+            return pathRepository.getNext(from, to);
+        });
+    }
 
     json j;
     j["tour"] = json::array();
-    for (int i = 0; i < tour.size(); ++i) {
-        Node current_node = nodeRepository.getNodeById(tour[i]).value();
-        int to_node_id = i < tour.size() - 1 ? tour[i + 1] : tour[0];
-
-        while (current_node.node_id != to_node_id) {
-            Station station =
-                stationRepository.getStationByCode(current_node.station_code)
-                    .value();
-
-            j["tour"].push_back({
-                {"station_code", station.station_code},
-            });
-            int next_node_id =
-                pathRepository.getNext(current_node.node_id, to_node_id);
-            current_node = nodeRepository.getNodeById(next_node_id).value();
-        }
+    for (int code : station_codes) {
+        Station station = stationRepository.getStationByCode(code).value();
+        j["tour"].push_back({
+            {"station_code", station.station_code},
+        });
     }
     cout << j << endl;
 
@@ -7,209 +7,390 @@ using namespace std;
 
 const int TOKYO = 1130101;
 
-int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        cerr << "Usage: ./tsp <station_file> <join_file> <group_file> "
-                "<output_dir>"
-             << endl;
-        return -1;
-    }
-
-    string station_file{argv[1]};
-    string join_file{argv[2]};
-    string group_file{argv[3]};
-    string output_dir{argv[4]};
-
-    vector<Station> stations = readStations(station_file);
-    StationRepository stationRepository(stations);
-
-    vector<Join> joins = readJoins(join_file);
-
-    vector<Group> groups = readGroup(group_file);
-    GroupRepository groupRepository(groups);
+// 前回のスナップショットの最短路木を新しいグラフの上でたどって距離の
+// 初期値とし、短くなる頂点だけを dijkstra と同じ順に直す。最後に全頂点で
+// dijkstra の木の条件を確かめ、満たさない始点は dijkstra で再計算するので、
+// 結果は全再計算と一致する。
+class IncrementalShortestPath {
+  public:
+    IncrementalShortestPath(const Graph &graph,
+                            const vector<vector<double>> &cost,
+                            const vector<Node> &prev_nodes,
+                            const CompressedPathRepository &prevPathRepository)
+        : prevPathRepository(prevPathRepository), N(graph.getNodeSize()),
+          M(prev_nodes.size()), to_new(M, -1), to_old(N, -1), neighbors(N) {
+        map<int, int> ids;
+        for (int v = 0; v < N; ++v) {
+            ids[graph.getNodeById(v).value().station_code] = v;
+        }
+        for (const Node &node : prev_nodes) {
+            auto it = ids.find(node.station_code);
+            if (it != ids.end()) {
+                to_new[node.node_id] = it->second;
+                to_old[it->second] = node.node_id;
+            }
+        }
 
-    NodeRepository nodeRepository;
-    Graph graph(&nodeRepository);
-    for (const Join &join : joins) {
-        if (!stationRepository.getStationByCode(join.station_code1)) {
-            continue;
+        for (int u = 0; u < N; ++u) {
+            for (int v : graph.getNeighbors(u)) {
+                neighbors[u].push_back({v, cost[u][v]});
+            }
         }
-        if (!stationRepository.getStationByCode(join.station_code2)) {
-            continue;
+    }
+
+    // 始点 i の列を前回の木から直せれば true
+    bool repair(int i, vector<vector<double>> &distance,
+                vector<vector<int>> &next) const {
+        int oi = to_old[i];
+        if (oi == -1) {
+            return false;
         }
 
-        Station station1 =
-            stationRepository.getStationByCode(join.station_code1).value();
-        Station station2 =
-            stationRepository.getStationByCode(join.station_code2).value();
+        // 前回の木の路を新しいグラフで足した長さは、今回の距離の上界になる
+        vector<Label> label(N, {DBL_MAX, INT_MAX});
+        traversePrevTree(oi, label);
 
-        if (!nodeRepository.getNodeByStationCode(station1.station_code)) {
-            if (!groupRepository.isSame(station1.station_code, TOKYO)) {
+        // 隣の駅から短くなる頂点を起点に、dijkstra と同じ順に直す
+        priority_queue<tuple<double, int, int>, vector<tuple<double, int, int>>,
+                       greater<tuple<double, int, int>>>
+            pq;
+        for (int v = 0; v < N; ++v) {
+            if (v == i) {
+                continue;
+            }
+            Label best = calcBestLabel(v, label).first;
+            if (best < label[v]) {
+                label[v] = best;
+                pq.push({best.first, best.second, v});
+            }
+        }
+        while (!pq.empty()) {
+            auto [d, h, u] = pq.top();
+            pq.pop();
+            if (Label{d, h} > label[u]) {
                 continue;
             }
-            int id = nodeRepository.size();
-            Node node{id, station1.station_code};
-            nodeRepository.addNode(node);
+            for (auto [v, c] : neighbors[u]) {
+                Label key{d + c, h + 1};
+                if (key < label[v]) {
+                    label[v] = key;
+                    pq.push({key.first, key.second, v});
+                }
+            }
         }
-        if (!nodeRepository.getNodeByStationCode(station2.station_code)) {
-            if (!groupRepository.isSame(station2.station_code, TOKYO)) {
+
+        // 各頂点の値が隣の駅から求めた最小値と一致すれば dijkstra と同じ解
+        vector<int> parent(N, -1);
+        for (int v = 0; v < N; ++v) {
+            if (v == i) {
                 continue;
             }
-            int id = nodeRepository.size();
-            Node node{id, station2.station_code};
-            nodeRepository.addNode(node);
+            auto [best, p] = calcBestLabel(v, label);
+            if (best != label[v]) {
+                return false;
+            }
+            parent[v] = p;
         }
 
-        Node node1 =
-            nodeRepository.getNodeByStationCode(station1.station_code).value();
-        Node node2 =
-            nodeRepository.getNodeByStationCode(station2.station_code).value();
-        graph.addEdge(node1, node2);
+        for (int v = 0; v < N; ++v) {
+            distance[i][v] = label[v].first;
+            next[v][i] = parent[v];
+        }
+        return true;
     }
 
-    const int N = graph.getNodeSize();
+  private:
+    // 距離と辺の数の組。dijkstra と同じく辞書順で比べる
+    using Label = pair<double, int>;
 
-    set<int> station_group_codes;
-    for (const Station &station : stations) {
-        if (!nodeRepository.getNodeByStationCode(station.station_code)) {
-            continue;
-        }
-        if (!groupRepository.isSame(station.station_code, TOKYO)) {
-            continue;
-        }
-        station_group_codes.insert(station.station_group_code);
-    }
-    for (int code : station_group_codes) {
-        vector<Station> stations =
-            stationRepository.getStationsByStationGroupCode(code);
-        if (stations.size() <= 1) {
-            continue;
-        }
-        for (int i = 0; i < stations.size(); ++i) {
-            Station station1 = stations[i];
-            if (!nodeRepository.getNodeByStationCode(station1.station_code)) {
-                continue;
-            }
-            Node node1 =
-                nodeRepository.getNodeByStationCode(station1.station_code)
-                    .value();
-            for (int j = 0; j < stations.size(); ++j) {
-                if (i == j) {
-                    continue;
+    const CompressedPathRepository &prevPathRepository;
+    const int N;
+    const int M;
+    vector<int> to_new;
+    vector<int> to_old;
+    vector<vector<pair<int, double>>> neighbors;
+
+    // 前回の木を根からたどり、今回のグラフにない駅や辺の先は未到達とする
+    void traversePrevTree(int oi, vector<Label> &label) const {
+        vector<bool> done(M, false);
+        vector<Label> prev_label(M, {DBL_MAX, INT_MAX});
+        prev_label[oi] = {0, 0};
+        done[oi] = true;
+        vector<int> stack;
+        for (int a = 0; a < M; ++a) {
+            int u = a;
+            while (!done[u]) {
+                stack.push_back(u);
+                int p = prevPathRepository.getNext(u, oi);
+                if (p == -1) {
+                    break;
                 }
-                Station station2 = stations[j];
-                if (!nodeRepository.getNodeByStationCode(
-                        station2.station_code)) {
-                    continue;
+                u = p;
+            }
+            if (!done[u]) {
+                done[u] = true;
+                stack.pop_back();
+            }
+            while (!stack.empty()) {
+                int w = stack.back();
+                stack.pop_back();
+                double c = calcCost(u, w);
+                if (prev_label[u].first != DBL_MAX && c != DBL_MAX) {
+                    prev_label[w] = {prev_label[u].first + c,
+                                     prev_label[u].second + 1};
                 }
-                Node node2 =
-                    nodeRepository.getNodeByStationCode(station2.station_code)
-                        .value();
-                graph.addEdge(node1, node2);
+                done[w] = true;
+                u = w;
+            }
+        }
+        for (int a = 0; a < M; ++a) {
+            if (to_new[a] != -1) {
+                label[to_new[a]] = prev_label[a];
             }
         }
     }
 
-    vector<vector<double>> cost(N, vector<double>(N, DBL_MAX));
-    set<Edge> edges = graph.getEdges();
-    for (const Edge &edge : edges) {
-        auto [from, to] = edge;
-
-        Node node1 = nodeRepository.getNodeById(from).value();
-        Station station1 =
-            stationRepository.getStationByCode(node1.station_code).value();
-        Node node2 = nodeRepository.getNodeById(to).value();
-        Station station2 =
-            stationRepository.getStationByCode(node2.station_code).value();
-
-        double distance = calcDistance({station1.lat, station1.lon},
-                                       {station2.lat, station2.lon});
-        cost[from][to] = distance;
-        cost[to][from] = distance;
+    // 前回の番号で表した辺の今回の長さ。辺がなければ DBL_MAX
+    double calcCost(int a, int b) const {
+        int u = to_new[a];
+        int v = to_new[b];
+        if (u == -1 || v == -1) {
+            return DBL_MAX;
+        }
+        for (auto [w, c] : neighbors[u]) {
+            if (w == v) {
+                return c;
+            }
+        }
+        return DBL_MAX;
     }
 
-    vector<vector<double>> distance(N, vector<double>(N, DBL_MAX));
-    vector<vector<int>> next(N, vector<int>(N, -1));
-#pragma omp parallel for
-    for (int i = 0; i < N; ++i) {
-        distance[i][i] = 0;
-        priority_queue<pair<double, int>, vector<pair<double, int>>,
-                       greater<pair<double, int>>>
-            pq;
-        pq.push({0, i});
-        while (!pq.empty()) {
-            auto [d, current] = pq.top();
-            pq.pop();
-            if (d > distance[i][current]) {
+    // 隣の駅から求めた v の最小の値と、それを与える番号最小の駅
+    pair<Label, int> calcBestLabel(int v, const vector<Label> &label) const {
+        Label best{DBL_MAX, INT_MAX};
+        int parent = -1;
+        for (auto [u, c] : neighbors[v]) {
+            if (label[u].first == DBL_MAX) {
                 continue;
             }
-            for (int neighbor : graph.getNeighbors(current)) {
-                if (d + cost[current][neighbor] < distance[i][neighbor]) {
-                    distance[i][neighbor] = d + cost[current][neighbor];
-                    pq.push({distance[i][neighbor], neighbor});
-                    next[neighbor][i] = current;
-                }
+            Label key{label[u].first + c, label[u].second + 1};
+            if (key < best || (key == best && u < parent)) {
+                best = key;
+                parent = u;
             }
         }
+        return {best, parent};
     }
+};
 
-    ofstream distance_file;
-    distance_file.open(output_dir + "/shortest_path.csv", ios::out);
+// 路線ごとの状態を持つグラフで最短路を求める。shortest_path.csv の行と
+// node.csv は状態ごと、列と railway.tsp は駅ごとになる。
+int writeStateGraph(const StateGraph &stateGraph, const string &output_dir) {
+    const int N = stateGraph.getNodeSize();
+    const int S = stateGraph.getStateSize();
 
-    vector<string> lines(N);
+    vector<vector<double>> distance(N);
+    vector<vector<int>> parent(N);
 #pragma omp parallel for
     for (int i = 0; i < N; ++i) {
-        // 高速化のため複数行まとめる
-        string s = "";
-        for (int j = 0; j < N; ++j) {
-            int n = next[i][j] == -1
-                        ? -1
-                        : graph.getNodeById(next[i][j]).value().node_id;
-            s += to_string(n) + ",";
+        stateGraph.calcShortestPath(i, distance[i], parent[i]);
+    }
+
+    AsyncWriter path_writer(output_dir + "/shortest_path.csv");
+    ostream distance_file(&path_writer);
+    for (int begin = 0; begin < S; begin += WRITE_CHUNK_SIZE) {
+        const int end = min(begin + WRITE_CHUNK_SIZE, S);
+        vector<string> lines(end - begin);
+#pragma omp parallel for
+        for (int v = begin; v < end; ++v) {
+            string s = "";
+            for (int i = 0; i < N; ++i) {
+                s += to_string(parent[i][v]) + ",";
+            }
+            s += "\n";
+            lines[v - begin] = std::move(s);
         }
-        lines[i] = s;
+        for (const string &line : lines) {
+            distance_file << line;
+        }
+    }
+    if (!path_writer.close()) {
+        cerr << "Failed to write file." << endl;
+        return 1;
     }
-    for (const string &line : lines) {
-        distance_file << line << endl;
+
+    ofstream path_file;
+    path_file.open(output_dir + "/shortest_path.bin", ios::out | ios::binary);
+    CompressedPathRepository(S, N, [&](int from, int to) {
+        return parent[to][from];
+    }).write(path_file);
+    path_file.close();
+    if (path_file.fail()) {
+        cerr << "Failed to write file." << endl;
+        return 1;
     }
 
     ofstream node_file;
     node_file.open(output_dir + "/node.csv", ios::out);
     node_file << "node_id,station_cd" << endl;
-    for (int i = 0; i < N; ++i) {
-        Node node = graph.getNodeById(i).value();
-        node_file << to_string(node.node_id) << ","
-                  << to_string(node.station_code) << endl;
-    }
-
-    ofstream tsp_file;
-    tsp_file.open(output_dir + "/railway.tsp", ios::out);
-    tsp_file << "NAME : railway" << endl;
-    tsp_file << "COMMENT : Japanese railway problem" << endl;
-    tsp_file << "TYPE : tsp" << endl;
-    tsp_file << "DIMENSION : " << N << endl;
-    tsp_file << "EDGE_WEIGHT_TYPE : EXPLICIT" << endl;
-    tsp_file << "EDGE_WEIGHT_FORMAT : FULL_MATRIX" << endl;
-    tsp_file << "EDGE_WEIGHT_SECTION" << endl;
-
-    lines = vector<string>(N);
-#pragma omp parallel for
-    for (int i = 0; i < N; ++i) {
-        // 高速化のため複数行まとめる
-        string s = "";
-        for (int j = 0; j < N; ++j) {
-            if (distance[i][j] == DBL_MAX) {
-                s += "-1 ";
-            } else {
-                s += to_string(lround(distance[i][j])) + " ";
+    for (int v = 0; v < S; ++v) {
+        node_file << to_string(v) << ","
+                  << to_string(stateGraph.getStationCode(v)) << endl;
+    }
+
+    // 各行の先頭 N 列が駅間の距離になる
+    AsyncWriter tsp_writer(output_dir + "/railway.tsp");
+    ostream tsp_file(&tsp_writer);
+    writeProblem(tsp_file, distance);
+    if (!tsp_writer.close()) {
+        cerr << "Failed to write file." << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    // --transfer を指定すると路線の乗り換えごとに penalty km を加える。
+    // --apsp で全点対最短路の求め方を選べ、auto ではグラフの密度で決める
+    optional<double> penalty;
+    optional<string> apsp;
+    while (argc >= 3) {
+        string option{argv[1]};
+        if (option == "--transfer") {
+            penalty = stod(argv[2]);
+        } else if (option == "--apsp") {
+            apsp = argv[2];
+        } else {
+            break;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    // --apsp は全点対最短路を一から求めるときだけ指定できる
+    if ((argc != 5 && argc != 6) || (penalty && argc != 5) ||
+        (apsp && (penalty || argc != 5 ||
+                  (apsp != "auto" && apsp != "dijkstra" && apsp != "floyd")))) {
+        cerr << "Usage: ./tsp [--transfer <penalty_km>] [--apsp "
+                "<auto|dijkstra|floyd>] <station_file> <join_file> "
+                "<group_file> <output_dir> [<prev_output_dir>]"
+             << endl;
+        return -1;
+    }
+
+    string station_file{argv[1]};
+    string join_file{argv[2]};
+    string group_file{argv[3]};
+    string output_dir{argv[4]};
+
+    vector<Station> stations = readStations(station_file);
+    StationRepository stationRepository(stations);
+
+    vector<Join> joins = readJoins(join_file);
+
+    vector<Group> groups = readGroup(group_file);
+    GroupRepository groupRepository(groups);
+
+    NodeRepository nodeRepository;
+    Graph graph(&nodeRepository);
+    buildGraph(
+        stations, stationRepository, joins,
+        [&](int code) { return groupRepository.isSame(code, TOKYO); },
+        nodeRepository, graph);
+
+    const int N = graph.getNodeSize();
+
+    if (penalty) {
+        return writeStateGraph(
+            StateGraph(graph, stationRepository, joins, penalty.value()),
+            output_dir);
+    }
+
+    vector<vector<double>> cost =
+        calcCost(graph, nodeRepository, stationRepository);
+
+    // 前回の出力を指定すると、その最短路木を直して使う
+    vector<Node> prev_nodes;
+    optional<CompressedPathRepository> prevPathRepository;
+    if (argc == 6) {
+        string prev_output_dir{argv[5]};
+        prev_nodes = readNode(prev_output_dir + "/node.csv");
+        prevPathRepository =
+            readCompressedShortestPath(prev_output_dir + "/shortest_path.bin");
+        if (!prevPathRepository) {
+            return 1;
+        }
+        const int M = prev_nodes.size();
+        bool valid = prevPathRepository->getRows() == M &&
+                     prevPathRepository->getColumns() == M;
+        for (const Node &node : prev_nodes) {
+            valid = valid && node.node_id >= 0 && node.node_id < M;
+        }
+        if (!valid) {
+            cerr << "Previous output does not match its node.csv." << endl;
+            return 1;
+        }
+    }
+
+    // railway.tsp は求まった行から書き出し、最短路の計算と重ねる
+    vector<vector<double>> distance(N, vector<double>(N, DBL_MAX));
+    vector<vector<int>> next(N, vector<int>(N, -1));
+    RowQueue rowQueue(N);
+    AsyncWriter tsp_writer(output_dir + "/railway.tsp");
+    ostream tsp_file(&tsp_writer);
+    thread problem_writer([&] { writeProblem(tsp_file, distance, rowQueue); });
+    if (prevPathRepository) {
+        IncrementalShortestPath incremental(graph, cost, prev_nodes,
+                                            *prevPathRepository);
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < N; ++i) {
+            if (!incremental.repair(i, distance, next)) {
+                dijkstra(i, graph, cost, distance, next);
             }
+            rowQueue.push(i);
+        }
+    } else if (apsp == "floyd" ||
+               (apsp.value_or("auto") == "auto" &&
+                FloydWarshall::isFaster(graph))) {
+        FloydWarshall(graph, cost).solve(distance, next);
+        for (int i = 0; i < N; ++i) {
+            rowQueue.push(i);
+        }
+    } else {
+#pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < N; ++i) {
+            dijkstra(i, graph, cost, distance, next);
+            rowQueue.push(i);
         }
-        lines[i] = s;
     }
-    for (const string &line : lines) {
-        tsp_file << line;
+    problem_writer.join();
+    if (!tsp_writer.close()) {
+        cerr << "Failed to write file." << endl;
+        return 1;
     }
-    tsp_file << endl << "EOF" << endl;
+
+    AsyncWriter path_writer(output_dir + "/shortest_path.csv");
+    ostream distance_file(&path_writer);
+    writeShortestPath(distance_file, next);
+    if (!path_writer.close()) {
+        cerr << "Failed to write file." << endl;
+        return 1;
+    }
+
+    ofstream path_file;
+    path_file.open(output_dir + "/shortest_path.bin", ios::out | ios::binary);
+    CompressedPathRepository(N, N, [&](int from, int to) {
+        return next[from][to];
+    }).write(path_file);
+    path_file.close();
+    if (path_file.fail()) {
+        cerr << "Failed to write file." << endl;
+        return 1;
+    }
+
+    ofstream node_file;
+    node_file.open(output_dir + "/node.csv", ios::out);
+    writeNode(node_file, nodeRepository);
 
     return 0;
 }
@@ -0,0 +1,19 @@
+#!/bin/bash
+# 標準入力から問題を読み、ノード ID 順のツアーを TOUR_FILE に書く
+par_file=$1
+problem_file=$(grep '^PROBLEM_FILE' $par_file | sed 's/^[^=]*= *//')
+tour_file=$(grep '^TOUR_FILE' $par_file | sed 's/^[^=]*= *//')
+problem=$(cat $problem_file)
+[ "$(echo "$problem" | tail -n 1)" == "EOF" ] || exit 1
+dimension=$(echo "$problem" | grep '^DIMENSION' | sed 's/^[^:]*: *//')
+{
+    echo "NAME : railway.tour"
+    echo "COMMENT : Length = 0"
+    echo "COMMENT : Found by fake_lkh"
+    echo "TYPE : TOUR"
+    echo "DIMENSION : $dimension"
+    echo "TOUR_SECTION"
+    seq 1 $dimension
+    echo "-1"
+    echo "EOF"
+} > $tour_file
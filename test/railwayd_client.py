@@ -0,0 +1,52 @@
+#!/usr/bin/env python3
+# 標準入力のリクエストを 1 つの接続でまとめて送り、応答を標準出力に書く。
+# その間、何も送らない接続を開いたままにし、別の接続から reload を送り続ける
+import socket
+import sys
+import threading
+
+IDLE_CONNECTIONS = 16
+RELOADS = 4
+
+
+def connect(path):
+    s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    s.connect(path)
+    return s
+
+
+def receive(s, count):
+    data = b""
+    while data.count(b"\n") < count:
+        chunk = s.recv(1 << 16)
+        if not chunk:
+            break
+        data += chunk
+    return data.decode()
+
+
+def reload(path, failures):
+    s = connect(path)
+    s.sendall(b"reload\n")
+    if receive(s, 1) != '{"reloaded":true}\n':
+        failures.append("reload")
+    s.close()
+
+
+path = sys.argv[1]
+requests = sys.stdin.read().splitlines()
+idle = [connect(path) for _ in range(IDLE_CONNECTIONS)]
+failures = []
+threads = [threading.Thread(target=reload, args=(path, failures))
+           for _ in range(RELOADS)]
+for thread in threads:
+    thread.start()
+s = connect(path)
+s.sendall("".join(request + "\n" for request in requests).encode())
+sys.stdout.write(receive(s, len(requests)))
+s.close()
+for thread in threads:
+    thread.join()
+for s in idle:
+    s.close()
+sys.exit(1 if failures else 0)
@@ -0,0 +1,24 @@
+#!/bin/bash
+program=$1
+source_dir=$2
+tmpfile=$(mktemp)
+$program $source_dir/test/expected/railway.tsp $source_dir/test/expected/railway.lkh 0.01 > $tmpfile
+diff $tmpfile $source_dir/test/expected/bound.csv || exit 1
+# ツアーを渡さなければ下界だけを出力する
+$program $source_dir/test/expected/railway.tsp > $tmpfile || exit 1
+diff $tmpfile $source_dir/test/expected/bound_only.csv || exit 1
+# ギャップが max_gap を超えれば 1 を返す
+$program $source_dir/test/data/railway_moved.tsp $source_dir/test/expected/reopt.lkh 0.01 > $tmpfile
+[ $? -eq 1 ] || exit 1
+diff $tmpfile $source_dir/test/expected/bound_gap.csv || exit 1
+# 保存した pi を読み込んでも同じ下界になる
+pi_file=$(mktemp)
+rm -f $pi_file
+$program $source_dir/test/expected/railway.tsp $source_dir/test/expected/railway.lkh 0.01 $pi_file > $tmpfile
+diff $tmpfile $source_dir/test/expected/bound.csv || exit 1
+[ -f $pi_file ] || exit 1
+$program $source_dir/test/expected/railway.tsp $source_dir/test/expected/railway.lkh 0.01 $pi_file > $tmpfile
+diff $tmpfile $source_dir/test/expected/bound.csv
+status=$?
+rm -f $tmpfile $pi_file
+exit $status
@@ -0,0 +1,6 @@
+#!/bin/bash
+program=$1
+source_dir=$2
+tmpfile=$(mktemp)
+$program $source_dir/test/data/station.csv $source_dir/test/data/query.csv 2 5 > $tmpfile
+diff $tmpfile $source_dir/test/expected/nearest.json
@@ -0,0 +1,15 @@
+#!/bin/bash
+set -e
+program=$1
+source_dir=$2
+output_dir=$3
+mkdir -p $output_dir
+tmpfile=$(mktemp)
+$program --dump $output_dir $source_dir/test/data/station.csv $source_dir/test/data/join.csv > $tmpfile
+diff $tmpfile $source_dir/test/expected/tour.json
+diff $output_dir/group.csv $source_dir/test/expected/group.csv
+diff $output_dir/shortest_path.csv $source_dir/test/expected/shortest_path.csv
+diff $output_dir/node.csv $source_dir/test/expected/node.csv
+cmp $output_dir/shortest_path.bin $source_dir/test/expected/shortest_path.bin
+$program --lkh $source_dir/test/fake_lkh.sh $source_dir/config/railway.par $source_dir/test/data/station.csv $source_dir/test/data/join.csv > $tmpfile
+diff $tmpfile $source_dir/test/expected/pipeline.json
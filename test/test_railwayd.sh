@@ -0,0 +1,23 @@
+#!/bin/bash
+program=$1
+source_dir=$2
+tmpfile=$(mktemp)
+$program - $source_dir/test/data/station.csv $source_dir/test/data/join.csv $source_dir/test/expected/group.csv $source_dir/test/expected/node.csv $source_dir/test/expected/shortest_path.bin < $source_dir/test/data/request.txt > $tmpfile
+diff $tmpfile $source_dir/test/expected/railwayd.json || exit 1
+# ソケットでも、待っている接続や reload と並んで同じ応答を返す
+socket_path=$(mktemp -u)
+$program $socket_path $source_dir/test/data/station.csv $source_dir/test/data/join.csv $source_dir/test/expected/group.csv $source_dir/test/expected/node.csv $source_dir/test/expected/shortest_path.bin &
+pid=$!
+for i in $(seq 50); do
+    [ -S $socket_path ] && break
+    sleep 0.1
+done
+timeout 10 $source_dir/test/railwayd_client.py $socket_path < $source_dir/test/data/request.txt > $tmpfile
+status=$?
+kill $pid
+rm -f $socket_path
+[ $status -eq 0 ] || exit 1
+diff $tmpfile $source_dir/test/expected/railwayd.json
+status=$?
+rm -f $tmpfile
+exit $status
@@ -0,0 +1,21 @@
+#!/bin/bash
+program=$1
+source_dir=$2
+tmpfile=$(mktemp)
+$program $source_dir/test/data/railway_updated.tsp $source_dir/test/data/node_updated.csv $source_dir/test/expected/railway.tsp $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh > $tmpfile
+diff $tmpfile $source_dir/test/expected/reopt.lkh || exit 1
+# 移動した駅の周辺も局所探索する
+$program $source_dir/test/data/railway_moved.tsp $source_dir/test/data/node_updated.csv $source_dir/test/data/railway_updated.tsp $source_dir/test/data/node_updated.csv $source_dir/test/expected/reopt.lkh > $tmpfile
+diff $tmpfile $source_dir/test/expected/reopt_moved.lkh || exit 1
+# --transfer の node.csv は状態の行を含むが、先頭の DIMENSION 行だけを使う
+$program $source_dir/test/expected/railway_transfer.tsp $source_dir/test/expected/node_transfer.csv $source_dir/test/expected/railway.tsp $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh > $tmpfile
+diff $tmpfile $source_dir/test/expected/reopt_transfer.lkh || exit 1
+# node.csv の行が DIMENSION に足りなければ失敗する
+status=0
+$program $source_dir/test/data/railway_updated.tsp $source_dir/test/expected/node.csv $source_dir/test/expected/railway.tsp $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh > $tmpfile || status=$?
+[ $status -eq 1 ] || exit 1
+# 前回のツアーが前回の node.csv と合わなければ失敗する
+status=0
+$program $source_dir/test/data/railway_updated.tsp $source_dir/test/data/node_updated.csv $source_dir/test/expected/railway.tsp $source_dir/test/expected/node.csv $source_dir/test/expected/reopt.lkh > $tmpfile || status=$?
+rm -f $tmpfile
+[ $status -eq 1 ]
@@ -1,6 +1,28 @@
 #!/bin/bash
+set -e
 program=$1
 source_dir=$2
 tmpfile=$(mktemp)
 $program $source_dir/test/data/station.csv $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh $source_dir/test/expected/shortest_path.csv > $tmpfile
 diff $tmpfile $source_dir/test/expected/tour.json
+$program $source_dir/test/data/station.csv $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh $source_dir/test/expected/shortest_path.bin > $tmpfile
+diff $tmpfile $source_dir/test/expected/tour.json
+# 途中で切れた shortest_path.bin は読み込みに失敗する
+binfile=$(mktemp --suffix=.bin)
+head -c 40 $source_dir/test/expected/shortest_path.bin > $binfile
+status=0
+$program $source_dir/test/data/station.csv $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh $binfile > $tmpfile || status=$?
+[ $status -eq 1 ]
+# 候補の数を超える番号を含む shortest_path.bin も読み込みに失敗する
+cp $source_dir/test/expected/shortest_path.bin $binfile
+printf '\xff' | dd of=$binfile bs=1 seek=60 conv=notrunc status=none
+status=0
+$program $source_dir/test/data/station.csv $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh $binfile > $tmpfile || status=$?
+[ $status -eq 1 ]
+# 大きすぎる行数を持つ shortest_path.bin は確保する前に読み込みに失敗する
+cp $source_dir/test/expected/shortest_path.bin $binfile
+printf '\xff\xff\xff\x7f' | dd of=$binfile bs=1 conv=notrunc status=none
+status=0
+$program $source_dir/test/data/station.csv $source_dir/test/expected/node.csv $source_dir/test/expected/railway.lkh $binfile > $tmpfile || status=$?
+[ $status -eq 1 ]
+rm -f $tmpfile $binfile
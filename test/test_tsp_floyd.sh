@@ -0,0 +1,13 @@
+#!/bin/bash
+set -e
+program=$1
+source_dir=$2
+output_dir=$3
+mkdir -p $output_dir/dijkstra $output_dir/floyd
+$program --apsp dijkstra $source_dir/test/data/station.csv $source_dir/test/data/join.csv $source_dir/test/expected/group.csv $output_dir/dijkstra
+$program --apsp floyd $source_dir/test/data/station.csv $source_dir/test/data/join.csv $source_dir/test/expected/group.csv $output_dir/floyd
+diff $output_dir/floyd/shortest_path.csv $output_dir/dijkstra/shortest_path.csv
+diff $output_dir/floyd/railway.tsp $output_dir/dijkstra/railway.tsp
+diff $output_dir/floyd/node.csv $output_dir/dijkstra/node.csv
+cmp $output_dir/floyd/shortest_path.bin $output_dir/dijkstra/shortest_path.bin
+diff $output_dir/floyd/shortest_path.csv $source_dir/test/expected/shortest_path.csv
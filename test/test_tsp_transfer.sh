@@ -0,0 +1,11 @@
+#!/bin/bash
+set -e
+program=$1
+source_dir=$2
+output_dir=$3
+mkdir -p $output_dir
+$program --transfer 5 $source_dir/test/data/station.csv $source_dir/test/data/join.csv $source_dir/test/expected/group.csv $output_dir
+diff $output_dir/shortest_path.csv $source_dir/test/expected/shortest_path_transfer.csv
+diff $output_dir/railway.tsp $source_dir/test/expected/railway_transfer.tsp
+diff $output_dir/node.csv $source_dir/test/expected/node_transfer.csv
+cmp $output_dir/shortest_path.bin $source_dir/test/expected/shortest_path_transfer.bin
@@ -0,0 +1,11 @@
+#!/bin/bash
+set -e
+program=$1
+source_dir=$2
+output_dir=$3
+mkdir -p $output_dir/full $output_dir/incremental
+$program $source_dir/test/data/station_updated.csv $source_dir/test/data/join_updated.csv $source_dir/test/data/group_updated.csv $output_dir/full
+$program $source_dir/test/data/station_updated.csv $source_dir/test/data/join_updated.csv $source_dir/test/data/group_updated.csv $output_dir/incremental $source_dir/test/expected
+diff $output_dir/incremental/shortest_path.csv $output_dir/full/shortest_path.csv
+diff $output_dir/incremental/railway.tsp $output_dir/full/railway.tsp
+diff $output_dir/incremental/node.csv $output_dir/full/node.csv